@@ -0,0 +1,71 @@
+/* exports
+ *   MCC_BUILD_ID, a digest of every source that goes into mcc, so that
+ *   compilation cache entries of another build are never reused
+ *   MCC_LLVM_VERSION, MCC_LLVM_BINDIR, the llvm mcc is built against, whose
+ *   clang links the profile and xray runtimes. LLVM_CONFIG names its
+ *   llvm-config when it is not the one on PATH, as for the cmake build */
+
+use std::env;
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::process::Command;
+
+#[path = "src/sha256.rs"]
+#[allow(dead_code)]
+mod sha256;
+
+const SOURCES: &[&str] = &["src", "ir-gen", "myrpg", "Cargo.lock", "CMakeLists.txt"];
+
+fn collect(path: &Path, files: &mut Vec<PathBuf>) {
+    if path.is_dir() {
+        for entry in fs::read_dir(path).into_iter().flatten().flatten() {
+            let name = entry.file_name();
+            /* build trees and vcs metadata are not sources */
+            if name == "target" || name.to_string_lossy().starts_with('.') {
+                continue;
+            }
+            collect(&entry.path(), files);
+        }
+    } else if path.is_file() {
+        files.push(path.to_owned());
+    }
+}
+
+fn llvm_config(arg: &str) -> String {
+    let tool = env::var("LLVM_CONFIG").unwrap_or_else(|_| String::from("llvm-config"));
+    Command::new(tool)
+        .arg(arg)
+        .output()
+        .ok()
+        .filter(|x| x.status.success())
+        .map_or(String::new(), |x| {
+            String::from_utf8_lossy(&x.stdout).trim().to_owned()
+        })
+}
+
+fn main() {
+    let mut files = vec![];
+    for source in SOURCES {
+        println!("cargo:rerun-if-changed={}", source);
+        collect(Path::new(source), &mut files);
+    }
+    files.sort();
+
+    let mut hasher = sha256::Sha256::new();
+    for file in files.iter() {
+        hasher.field(file.to_string_lossy().as_bytes());
+        hasher.field(&fs::read(file).unwrap_or_default());
+    }
+    println!("cargo:rustc-env=MCC_BUILD_ID={}", hasher.finish());
+
+    println!("cargo:rerun-if-env-changed=LLVM_CONFIG");
+    let version = llvm_config("--version");
+    if version.is_empty() {
+        println!("cargo:warning=llvm-config not found, -fprofile-generate and -fxray-instrument cannot link");
+    }
+    println!("cargo:rustc-env=MCC_LLVM_VERSION={}", version);
+    println!(
+        "cargo:rustc-env=MCC_LLVM_BINDIR={}",
+        llvm_config("--bindir")
+    );
+}
@@ -9,17 +9,61 @@
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 
+#define MCC_TARGET(T) \
+    extern "C" void LLVMInitialize##T##TargetInfo(); \
+    extern "C" void LLVMInitialize##T##Target(); \
+    extern "C" void LLVMInitialize##T##TargetMC(); \
+    extern "C" void LLVMInitialize##T##AsmPrinter();
+#include "mcc/Targets.def"
+#undef MCC_TARGET
+#define MCC_ASM_PARSER(T) \
+    extern "C" void LLVMInitialize##T##AsmParser();
+#include "mcc/AsmParsers.def"
+#undef MCC_ASM_PARSER
+
+static void init_cross_targets()
+{
+#define MCC_TARGET(T) \
+    LLVMInitialize##T##TargetInfo(); \
+    LLVMInitialize##T##Target(); \
+    LLVMInitialize##T##TargetMC(); \
+    LLVMInitialize##T##AsmPrinter();
+#include "mcc/Targets.def"
+#undef MCC_TARGET
+    // only the backends that have one, --mca-report reads the assembly back
+#define MCC_ASM_PARSER(T) \
+    LLVMInitialize##T##AsmParser();
+#include "mcc/AsmParsers.def"
+#undef MCC_ASM_PARSER
+}
+
+const Target *lookup_target(const std::string &triple, std::string &err)
+{
+    static bool cross_targets_ready = false;
+
+    auto target = TargetRegistry::lookupTarget(triple, err);
+    if (!target && !cross_targets_ready)
+    {
+        // only pay for the other backends when we are actually asked to cross compile
+        init_cross_targets();
+        cross_targets_ready = true;
+        err.clear();
+        target = TargetRegistry::lookupTarget(triple, err);
+    }
+    return target;
+}
+
 extern "C" {
 
-MsgList *init_be(int debug)
+MsgList *init_be(const CompileOptions *opts)
 {
-    InitializeAllTargetInfos();
-    InitializeAllTargets();
-    InitializeAllTargetMCs();
-    InitializeAllAsmParsers();
-    InitializeAllAsmPrinters();
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
 
-    is_debug_mode = debug != 0;
+    compileOptions = *opts;
+    targetTriple = opts->triple ? opts->triple : sys::getDefaultTargetTriple();
+    is_debug_mode = opts->debug != 0;
 
     auto msg_l = new MsgList();
     infoList = msg_l;
@@ -2,9 +2,17 @@
 
 #include "common.h"
 
+namespace llvm
+{
+class Target;
+}
+
+// find the backend for `triple`, initializing the non-native ones on first use
+const llvm::Target *lookup_target(const std::string &triple, std::string &err);
+
 extern "C" {
 
-MsgList *init_be(int debug);
+MsgList *init_be(const CompileOptions *opts);
 
 void clear_msg();
 
@@ -21,6 +21,7 @@
 #include <deque>
 
 #include "msglist.h"
+#include "options.h"
 #include "utility.h"
 #include "macros.h"
 
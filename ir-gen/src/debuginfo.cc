@@ -0,0 +1,357 @@
+#include "debuginfo.h"
+#include "global.h"
+#include "type/def.h"
+
+#include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+std::unique_ptr<DebugInfo> TheDebugInfo;
+
+// `# 12 "file.c" 2` as printed by the preprocessor, or `#line 12 "file.c"`
+static bool parse_marker( StringRef text, unsigned &line, std::string &name, bool &has_flags )
+{
+	text = text.ltrim();
+	if ( !text.consume_front( "#" ) ) return false;
+	text = text.ltrim();
+	text.consume_front( "line" );
+	text = text.ltrim();
+	if ( text.consumeInteger( 10, line ) ) return false;
+	text = text.ltrim();
+	if ( !text.consume_front( "\"" ) ) return false;
+
+	name.clear();
+	for ( ; !text.empty() && text.front() != '"'; text = text.drop_front() )
+	{
+		if ( text.front() == '\\' && text.size() > 1 ) text = text.drop_front();
+		name += text.front();
+	}
+	if ( !text.consume_front( "\"" ) ) return false;
+	has_flags = !text.trim().empty();
+	return true;
+}
+
+DIFile *DebugInfo::get_file( const std::string &name )
+{
+	SmallString<128> dir;
+	sys::fs::current_path( dir );
+	return builder.createFile( name, dir );
+}
+
+DebugInfo::DebugInfo( Module &module, StringRef source ) :
+  builder( module ),
+  full( compileOptions.debug_info )
+{
+	// positions count lines from zero, like the rows of a message
+	std::map<std::string, unsigned> ids;
+	auto file_id = [&]( const std::string &name ) {
+		auto it = ids.find( name );
+		if ( it != ids.end() ) return it->second;
+		files.push_back( get_file( name ) );
+		return ids[ name ] = files.size() - 1;
+	};
+
+	// the file compiled is the first one named by a marker of its own,
+	// included files come with flags
+	std::string main_file = "<stdin>";
+	unsigned file = -1, line = 1;
+	SmallVector<StringRef, 0> text;
+	source.split( text, '\n' );
+	for ( auto &text_line : text )
+	{
+		std::string name;
+		unsigned marker_line;
+		bool has_flags;
+		if ( parse_marker( text_line, marker_line, name, has_flags ) )
+		{
+			if ( !has_flags && file == unsigned( -1 ) && !StringRef( name ).startswith( "<" ) )
+			{
+				main_file = name;
+			}
+			lines.emplace_back( file, line );
+			file = file_id( name );
+			line = marker_line;
+			continue;
+		}
+		lines.emplace_back( file, line++ );
+	}
+	// text before the first marker, the rest of a precompiled header
+	auto main_id = file_id( main_file );
+	for ( auto &entry : lines )
+	{
+		if ( entry.first == unsigned( -1 ) ) entry.first = main_id;
+	}
+
+	auto profiling = compileOptions.profile_sample_use != nullptr;
+	unit = builder.createCompileUnit(
+	  dwarf::DW_LANG_C89, files[ main_id ], "mcc", false, "", 0, "",
+	  full ? DICompileUnit::FullDebug : DICompileUnit::LineTablesOnly, 0, true, profiling );
+
+	module.addModuleFlag( Module::Warning, "Dwarf Version", 4 );
+	module.addModuleFlag( Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION );
+}
+
+const std::pair<unsigned, unsigned> &DebugInfo::get_line( const Json::Value &node ) const
+{
+	auto row = node[ "pos" ][ 0 ].asUInt64();
+	return lines[ row < lines.size() ? row : 0 ];
+}
+
+DILocation *DebugInfo::location( const Json::Value &node, bool end ) const
+{
+	if ( scopes.empty() || !node.isObject() || !node.isMember( "pos" ) ) return nullptr;
+	auto &pos = node[ "pos" ];
+	auto row = pos[ end ? 2 : 0 ].asUInt64();
+	auto col = pos[ end ? 3 : 1 ].asUInt();
+	if ( row >= lines.size() ) return nullptr;
+	return DILocation::get( TheContext, lines[ row ].second, col + 1, scopes.back() );
+}
+
+bool DebugInfo::find_position( StringRef file, unsigned line, unsigned col, std::size_t ( &pos )[ 4 ] ) const
+{
+	for ( std::size_t row = 0; row != lines.size(); ++row )
+	{
+		if ( lines[ row ].second == line && files[ lines[ row ].first ]->getFilename() == file )
+		{
+			auto from = col ? col - 1 : 0;
+			pos[ 0 ] = pos[ 2 ] = row;
+			pos[ 1 ] = from;
+			pos[ 3 ] = from + 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+void DebugInfo::begin_function( Function *fn, const TypeView &type, const Json::Value &node )
+{
+	auto &line = get_line( node );
+	auto file = files[ line.first ];
+
+	auto fn_type = full ? cast<DISubroutineType>( get_type( type ) )
+						: builder.createSubroutineType( builder.getOrCreateTypeArray( {} ) );
+	auto flags = DISubprogram::SPFlagDefinition;
+	if ( fn->hasLocalLinkage() ) flags |= DISubprogram::SPFlagLocalToUnit;
+	auto sp = builder.createFunction( file, fn->getName(), StringRef(), file, line.second,
+									  fn_type, line.second, DINode::FlagPrototyped, flags );
+	fn->setSubprogram( sp );
+	scopes.assign( 1, sp );
+}
+
+void DebugInfo::end_function()
+{
+	builder.finalizeSubprogram( cast<DISubprogram>( scopes.front() ) );
+	scopes.clear();
+}
+
+void DebugInfo::begin_outlined( Function *fn, const Json::Value &node )
+{
+	suspended.push_back( std::move( scopes ) );
+
+	auto &line = get_line( node );
+	auto file = files[ line.first ];
+	auto sp = builder.createFunction( file, fn->getName(), StringRef(), file, line.second,
+									  builder.createSubroutineType( builder.getOrCreateTypeArray( {} ) ),
+									  line.second, DINode::FlagArtificial | DINode::FlagPrototyped,
+									  DISubprogram::SPFlagDefinition | DISubprogram::SPFlagLocalToUnit );
+	fn->setSubprogram( sp );
+	scopes.assign( 1, sp );
+}
+
+void DebugInfo::end_outlined()
+{
+	end_function();
+	scopes = std::move( suspended.back() );
+	suspended.pop_back();
+}
+
+void DebugInfo::begin_block( const Json::Value &node )
+{
+	if ( !full || scopes.empty() ) return;
+	auto &line = get_line( node );
+	auto col = node[ "pos" ][ 1 ].asUInt();
+	scopes.push_back( builder.createLexicalBlock( scopes.back(), files[ line.first ], line.second, col + 1 ) );
+}
+
+void DebugInfo::end_block()
+{
+	if ( !full || scopes.empty() ) return;
+	scopes.pop_back();
+}
+
+DIType *DebugInfo::get_type( TypeView view )
+{
+	auto ty = view.get();
+	auto base = get_unqualified_type( view );
+	if ( base && ty->is_const ) base = builder.createQualifiedType( dwarf::DW_TAG_const_type, base );
+	if ( base && ty->is_volatile ) base = builder.createQualifiedType( dwarf::DW_TAG_volatile_type, base );
+	return base;
+}
+
+DIType *DebugInfo::get_unqualified_type( TypeView view )
+{
+	auto ty = view.get();
+	auto size = [&]( Type *type ) -> uint64_t {
+		return type->isSized() ? TheDataLayout->getTypeAllocSizeInBits( type ) : 0;
+	};
+	auto align = [&]( Type *type ) -> uint32_t {
+		return type->isSized() ? TheDataLayout->getABITypeAlignment( type ) * 8 : 0;
+	};
+
+	if ( ty->is<mty::Void>() )
+	{
+		return nullptr;
+	}
+	if ( ty->is<mty::Integer>() || ty->is<mty::FloatingPoint>() )
+	{
+		// named like diagnostics name them, without the qualifiers
+		auto unqualified = ty->clone();
+		unqualified->is_const = unqualified->is_volatile = false;
+		std::ostringstream name;
+		unqualified->print( name, { unqualified }, 0 );
+
+		unsigned encoding = dwarf::DW_ATE_float;
+		if ( auto integer = ty->as<mty::Integer>() )
+		{
+			if ( integer->bits == 1 )
+				encoding = dwarf::DW_ATE_boolean;
+			else if ( integer->bits == 8 )
+				encoding = integer->is_signed ? dwarf::DW_ATE_signed_char : dwarf::DW_ATE_unsigned_char;
+			else
+				encoding = integer->is_signed ? dwarf::DW_ATE_signed : dwarf::DW_ATE_unsigned;
+		}
+		return builder.createBasicType( name.str(), size( ty->type ), encoding );
+	}
+	if ( ty->is<mty::Pointer>() )
+	{
+		auto pointee = get_type( view.next() );
+		return builder.createPointerType( pointee, TheDataLayout->getPointerSizeInBits() );
+	}
+	if ( auto fn = ty->as<mty::Function>() )
+	{
+		SmallVector<Metadata *, 8> types;
+		types.push_back( get_type( view.next() ) );
+		for ( auto &arg : fn->args )
+		{
+			types.push_back( get_type( TypeView( std::make_shared<QualifiedType>( arg.type ) ) ) );
+		}
+		if ( fn->is_va_args ) types.push_back( builder.createUnspecifiedParameter() );
+		return builder.createSubroutineType( builder.getOrCreateTypeArray( types ) );
+	}
+	if ( auto array = ty->as<mty::Array>() )
+	{
+		auto count = array->len.is_some() ? int64_t( array->len.unwrap() ) : -1;
+		auto element = get_type( TypeView( view ).next() );
+		auto subscripts = builder.getOrCreateArray( { builder.getOrCreateSubrange( 0, count ) } );
+		return builder.createArrayType( count < 0 ? 0 : size( ty->type ), align( ty->type ), element, subscripts );
+	}
+	if ( auto vector = ty->as<mty::Vector>() )
+	{
+		// the element is not part of the type list, only of the llvm type
+		auto element_ty = cast<llvm::VectorType>( ty->type )->getElementType();
+		std::string element_name;
+		raw_string_ostream( element_name ) << *element_ty;
+		auto element = builder.createBasicType(
+		  element_name, size( element_ty ),
+		  element_ty->isFloatingPointTy() ? dwarf::DW_ATE_float : dwarf::DW_ATE_signed );
+		auto subscripts = builder.getOrCreateArray( { builder.getOrCreateSubrange( 0, vector->len ) } );
+		return builder.createVectorType( size( ty->type ), align( ty->type ), element, subscripts );
+	}
+
+	auto record = ty->as<mty::Struct>();
+	auto variant = ty->as<mty::Union>();
+	if ( !record && !variant ) INTERNAL_ERROR( "no debug info for type" );
+
+	auto tag = record ? dwarf::DW_TAG_structure_type : dwarf::DW_TAG_union_type;
+	auto &name = record ? record->name : variant->name;
+	auto tag_name = name.is_some() ? name.unwrap() : "";
+	if ( !ty->is_complete() )
+	{
+		return builder.createForwardDecl( tag, tag_name, unit, unit->getFile(), 0 );
+	}
+
+	// members may point back to the type, so it is cached before they are
+	auto cached = composites.find( ty->type );
+	if ( cached != composites.end() ) return cached->second;
+
+	DICompositeType *composite;
+	SmallVector<Metadata *, 8> members;
+	auto add_member = [&]( const std::string &name, const QualifiedType &type, uint64_t offset ) {
+		members.push_back( builder.createMemberType(
+		  composite, name, unit->getFile(), 0, size( type->type ), align( type->type ), offset,
+		  DINode::FlagZero, get_type( TypeView( std::make_shared<QualifiedType>( type ) ) ) ) );
+	};
+	if ( record )
+	{
+		composite = builder.createStructType( unit, tag_name, unit->getFile(), 0, size( ty->type ),
+											  align( ty->type ), DINode::FlagZero, nullptr, DINodeArray() );
+		composites[ ty->type ] = composite;
+		auto layout = TheDataLayout->getStructLayout( static_cast<llvm::StructType *>( ty->type ) );
+		auto &comps = record->decl->sel_comps;
+		for ( unsigned i = 0; i != comps.size(); ++i )
+		{
+			add_member( comps[ i ].name.unwrap(), comps[ i ].type, layout->getElementOffsetInBits( i ) );
+		}
+	}
+	else
+	{
+		composite = builder.createUnionType( unit, tag_name, unit->getFile(), 0, size( ty->type ),
+											 align( ty->type ), DINode::FlagZero, DINodeArray() );
+		composites[ ty->type ] = composite;
+		for ( auto &comp : variant->decl->comps )
+		{
+			add_member( comp.first, comp.second, 0 );
+		}
+	}
+	builder.replaceArrays( composite, builder.getOrCreateArray( members ) );
+	return composites[ ty->type ] = composite;
+}
+
+void DebugInfo::declare_variable( Value *storage, const std::string &name, const TypeView &type,
+								  const Json::Value &node, unsigned arg )
+{
+	if ( !full || scopes.empty() ) return;
+	auto &line = get_line( node );
+	auto file = files[ line.first ];
+	auto ty = get_type( type );
+	auto var = arg ? builder.createParameterVariable( scopes.back(), name, arg, file, line.second, ty )
+				   : builder.createAutoVariable( scopes.back(), name, file, line.second, ty );
+	auto loc = location( node );
+	if ( !loc ) loc = DILocation::get( TheContext, line.second, 0, scopes.back() );
+	builder.insertDeclare( storage, var, builder.createExpression(), loc, Builder.GetInsertBlock() );
+}
+
+void DebugInfo::declare_global( GlobalVariable *var, const std::string &name, const TypeView &type,
+								const Json::Value &node )
+{
+	if ( !full ) return;
+	auto &line = get_line( node );
+	auto file = files[ line.first ];
+	// a static local belongs to its function
+	DIScope *scope = scopes.empty() ? static_cast<DIScope *>( unit ) : scopes.back();
+	auto expr = builder.createGlobalVariableExpression(
+	  scope, name, StringRef(), file, line.second, get_type( type ), var->hasLocalLinkage() );
+	var->addDebugInfo( expr );
+}
+
+void DebugInfo::finalize()
+{
+	builder.finalize();
+}
+
+LocationScope::LocationScope( const Json::Value &node ) :
+  saved( Builder.getCurrentDebugLocation() )
+{
+	if ( TheDebugInfo )
+	{
+		if ( auto loc = TheDebugInfo->location( node ) )
+		{
+			Builder.SetCurrentDebugLocation( loc );
+		}
+	}
+}
+
+LocationScope::~LocationScope()
+{
+	Builder.SetCurrentDebugLocation( saved );
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "common.h"
+
+#include "llvm/IR/DIBuilder.h"
+
+class TypeView;
+
+// debug info of TheModule. Nodes carry their position in the preprocessed
+// text, the line markers of that text take them back to the source files.
+// Only the line tables are emitted unless -g asks for types and variables.
+class DebugInfo
+{
+	DIBuilder builder;
+	DICompileUnit *unit;
+	bool full;
+	std::vector<DIFile *> files;
+	std::vector<std::pair<unsigned, unsigned>> lines;  // file and line of each preprocessed line
+	std::vector<DIScope *> scopes;						 // the function and its blocks
+	std::vector<std::vector<DIScope *>> suspended;		 // of the functions loops are outlined from
+	std::map<Type *, DIType *> composites;
+
+	DIFile *get_file( const std::string &name );
+	const std::pair<unsigned, unsigned> &get_line( const Json::Value &node ) const;
+	DIType *get_unqualified_type( TypeView view );
+
+public:
+	DebugInfo( Module &module, StringRef source );
+
+	// line of a node and its end in the source, null outside of a function
+	DILocation *location( const Json::Value &node, bool end = false ) const;
+
+	// the other way round, position in the preprocessed text of a source line
+	bool find_position( StringRef file, unsigned line, unsigned col, std::size_t ( &pos )[ 4 ] ) const;
+
+	// the body of `fn` is generated from `node` next
+	void begin_function( Function *fn, const TypeView &type, const Json::Value &node );
+	void end_function();
+
+	// the body of the loop at `node` is outlined into `fn`, its scopes are
+	// those of `fn` until it is done
+	void begin_outlined( Function *fn, const Json::Value &node );
+	void end_outlined();
+
+	// scope of the variables of a compound statement
+	void begin_block( const Json::Value &node );
+	void end_block();
+
+	DIType *get_type( TypeView view );
+
+	// `storage` is the address of a local variable, or of parameter `arg` counting from 1
+	void declare_variable( Value *storage, const std::string &name, const TypeView &type,
+						   const Json::Value &node, unsigned arg = 0 );
+	void declare_global( GlobalVariable *var, const std::string &name, const TypeView &type,
+						 const Json::Value &node );
+
+	// resolves what is left of the metadata, before the module is verified
+	void finalize();
+};
+
+extern std::unique_ptr<DebugInfo> TheDebugInfo;
+
+// points Builder at a node while it is generated
+class LocationScope
+{
+	DebugLoc saved;
+
+public:
+	LocationScope( const Json::Value &node );
+	~LocationScope();
+};
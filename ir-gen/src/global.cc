@@ -14,8 +14,54 @@ std::stack<std::map<ConstantInt *, BasicBlock *>> caseList;
 std::stack<std::pair<bool, BasicBlock *>> defaultList;
 std::stack<int> switchBits;
 MsgList *infoList;
+CompileOptions compileOptions;
 ScopedMap<Symbol> symTable;
 ScopedMap<Global> globObjects;
 bool stack_trace = false;
 std::string decl_indent;
 bool is_debug_mode = false;
+std::string targetTriple;
+
+Value *materialize_global( const std::string &name, const TypeView &type )
+{
+	auto glob = globObjects.find( name );
+	if ( auto fn_type = type->as<mty::Function>() )
+	{
+		auto &abi_info = fn_type->abi_info();
+		auto fn = TheModule->getFunction( name );
+		if ( !fn || ( fn->isDeclaration() && fn->getFunctionType() != abi_info.type ) )
+		{
+			auto decl = fn;
+			fn = Function::Create( abi_info.type, GlobalValue::ExternalLinkage, name, TheModule.get() );
+			abi::apply_attributes( fn, abi_info );
+			if ( glob ) glob->attrs.apply( fn );
+			if ( decl )
+			{  // used while one of its aggregates was incomplete
+				fn->takeName( decl );
+				fn->setLinkage( decl->getLinkage() );
+				decl->replaceAllUsesWith( ConstantExpr::getBitCast( fn, decl->getType() ) );
+				decl->eraseFromParent();
+			}
+		}
+		if ( fn->getFunctionType() != fn_type->type )
+		{
+			return ConstantExpr::getBitCast( fn, PointerType::getUnqual( fn_type->type ) );
+		}
+		return fn;
+	}
+	else
+	{
+		if ( auto var = TheModule->getNamedGlobal( name ) )
+		{  // defined with a literal initializer type, see set_initializer
+			if ( var->getValueType() != type->type )
+			{
+				return ConstantExpr::getBitCast( var, PointerType::getUnqual( type->type ) );
+			}
+			return var;
+		}
+		auto var = new GlobalVariable( *TheModule, type->type, false,
+									   GlobalValue::ExternalLinkage, nullptr, name );
+		if ( glob ) glob->attrs.apply( var );
+		return var;
+	}
+}
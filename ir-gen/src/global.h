@@ -5,15 +5,17 @@
 
 struct Global
 {
-	QualifiedValue value;
+	QualifiedValue value;  // value.get() is null until an external declaration is used
 	bool is_internal;
 	bool is_allocated;
+	GnuAttributes attrs;  // attributes to apply once the declaration is emitted
 
 	Global( const QualifiedValue &val, bool is_internal = false,
-			bool is_allocated = false ) :
+			bool is_allocated = false, const GnuAttributes &attrs = GnuAttributes() ) :
 	  value( val ),
 	  is_internal( is_internal ),
-	  is_allocated( is_allocated )
+	  is_allocated( is_allocated ),
+	  attrs( attrs )
 	{
 	}
 };
@@ -80,8 +82,13 @@ extern std::stack<std::map<ConstantInt *, BasicBlock *>> caseList;
 extern std::stack<std::pair<bool, BasicBlock *>> defaultList;
 extern std::stack<int> switchBits;;
 extern ffi::MsgList *infoList;
+extern ffi::CompileOptions compileOptions;
 extern ScopedMap<Symbol> symTable;
 extern ScopedMap<Global> globObjects;
 extern bool stack_trace;
 extern std::string decl_indent;
 extern bool is_debug_mode;
+
+// emit the llvm object of the external declaration `name` on first use
+Value *materialize_global( const std::string &name, const TypeView &type );
+extern std::string targetTriple;
@@ -1,211 +1,293 @@
 #include "common.h"
+#include "debuginfo.h"
 #include "global.h"
+#include "irgen.h"
 #include "node/def.h"
+#include "parallel.h"
+#include "target.h"
+#include "workshare.h"
+
+#include "llvm/Support/SpecialCaseList.h"
+
+// -fxray-always-instrument and -fxray-never-instrument, loaded per compile
+static std::unique_ptr<SpecialCaseList> xrayAlways, xrayNever;
+
+static std::unique_ptr<SpecialCaseList> load_xray_list( const char *path )
+{
+	if ( !path ) return nullptr;
+	std::string err;
+	auto list = SpecialCaseList::create( { path }, err );
+	if ( !list )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, fmt( "cannot read xray function list: ", err ) );
+		HALT();
+	}
+	return list;
+}
+
+// sleds are emitted by the backend for every function with these attributes,
+// they cost a few nops until the runtime patches them
+static void set_xray_attributes( Function *fn )
+{
+	auto name = fn->getName();
+	if ( xrayAlways && xrayAlways->inSection( "", "fun", name ) )
+	{
+		fn->addFnAttr( "function-instrument", "xray-always" );
+	}
+	else if ( xrayNever && xrayNever->inSection( "", "fun", name ) )
+	{
+		fn->addFnAttr( "function-instrument", "xray-never" );
+	}
+	else
+	{
+		fn->addFnAttr( "xray-instruction-threshold", std::to_string( compileOptions.xray_threshold ) );
+	}
+}
+
+// checks the prototype of a function definition and makes it visible
+static FunctionDefinition declare_function( Json::Value &node )
+{
+	Json::Value &children = node[ "children" ];
+
+	auto declspec = get<DeclarationSpecifiers>( codegen( children[ 0 ], true ) );
+
+	if ( declspec.has_attribute( SC_TYPEDEF ) )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, "function definition declared `typedef`", children[ 0 ] );
+		HALT();
+	}
+	if ( declspec.has_attribute( SC_REGISTER ) || declspec.has_attribute( SC_AUTO ) )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, "illegal storage class on function", children[ 0 ] );
+		HALT();
+	}
+
+	auto builder = declspec.into_type_builder(
+	  children[ 0 ][ "type" ].asString() == "empty_declaration_specifiers" ? children[ 1 ] : children[ 0 ] );
+
+	auto decl = get<QualifiedDecl>( codegen( children[ 1 ], &builder ) );
+	auto type = decl.type;
+	auto name = decl.name.unwrap();
+
+	dbg( "=== Function ", name, " ===" );
+
+	if ( !type.is<mty::Function>() )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, "expected a function defination", children[ 0 ] );
+		HALT();
+	}
+
+	auto fn_type = type.as<mty::Function>();
+	int errors = 0;
+
+	for ( auto &arg : fn_type->args )
+	{
+		if ( !arg.type->is_valid_parameter_type() )
+		{
+			if ( !arg.type->is_complete() )
+			{
+				infoList->add_msg(
+				  MSG_TYPE_ERROR,
+				  fmt( "variable of incomplete type `", arg.type, "` cannot be used as function parameter" ),
+				  node );
+				errors++;
+			}
+			else
+			{
+				// checked already
+				INTERNAL_ERROR();
+			}
+		}
+	}
+
+	if ( errors ) HALT();
+
+	if ( auto sym = symTable.find_in_scope( name ) )
+	{
+		if ( sym->is_type() )
+		{
+			infoList->add_msg(
+			  MSG_TYPE_ERROR,
+			  fmt( "redefination of `", name, "` as different kind of symbol" ),
+			  node );
+			HALT();
+		}
+		auto val = sym->as_value();
+		auto view = TypeView( std::make_shared<QualifiedType>( type ) );
+		if ( !val.get_type().is_same( view ) )
+		{
+			infoList->add_msg(
+			  MSG_TYPE_ERROR,
+			  fmt( "forward declaration of `", name, "` conflicts" ),
+			  node );
+			HALT();
+		}
+	}
+
+	// also emits a prototype that has not been used yet, with its attributes
+	auto fn = static_cast<Function *>(
+	  materialize_global( name, TypeView( std::make_shared<QualifiedType>( type ) ) ) );
+	declspec.get_gnu_attributes().apply( fn );
+	decl.attrs.apply( fn );
+
+	symTable.insert(
+	  name,
+	  QualifiedValue( std::make_shared<QualifiedType>( type ), fn, false ),
+	  children[ 1 ] );
+
+	return FunctionDefinition{ &node, type, name, fn, symTable.mark() };
+}
+
+static void define_function( const FunctionDefinition &def )
+{
+	Json::Value &children = ( *def.node )[ "children" ];
+	auto type = def.type;
+	auto &name = def.name;
+	auto fn = def.fn;
+	auto fn_type = type.as<mty::Function>();
+
+	gotoJump.clear();
+	labelJump.clear();
+
+	Builder.setFastMathFlags( TheTargetInfo->fast_math_flags() );
+	TheTargetInfo->set_fp_attributes( fn );
+
+	currentFunction = std::make_shared<QualifiedValue>(
+	  std::make_shared<QualifiedType>( type ), fn, false );
+	funcName = name;
+	BasicBlock *BB = BasicBlock::Create( TheContext, "entry", fn );
+	Builder.SetInsertPoint( BB );
+	if ( TheDebugInfo )
+	{
+		TheDebugInfo->begin_function( fn, TypeView( std::make_shared<QualifiedType>( type ) ), *def.node );
+	}
+	if ( compileOptions.xray_instrument ) set_xray_attributes( fn );
+	if ( compileOptions.no_omit_frame_pointer )
+	{
+		// llvm 8 reads the first, later releases the second
+		fn->addFnAttr( "no-frame-pointer-elim", "true" );
+		fn->addFnAttr( "frame-pointer", "all" );
+	}
+
+	symTable.push();
+
+	auto fn_arg = fn->arg_begin();
+	if ( fn_type->abi_info().ret.kind == abi::Indirect )
+	{
+		( fn_arg++ )->setName( "agg.result" );
+	}
+	for ( unsigned i = 0; i != fn_type->args.size(); ++i )
+	{
+		auto &arg = fn_type->args[ i ];
+		if ( arg.name.is_none() )
+		{
+			infoList->add_msg(
+			  MSG_TYPE_ERROR,
+			  fmt( "function parameter name omitted" ),
+			  children[ 1 ] );
+			HALT();
+		}
+		auto &name = arg.name.unwrap();
+		auto alloc = abi::lower_parameter( fn_type->abi_info().args[ i ], &*fn_arg, arg.type->type, name );
+		if ( TheDebugInfo )
+		{
+			TheDebugInfo->declare_variable(
+			  alloc, name, TypeView( std::make_shared<QualifiedType>( arg.type ) ), children[ 1 ], i + 1 );
+		}
+		symTable.insert_if(
+		  name,
+		  QualifiedValue(
+			TypeView( std::make_shared<QualifiedType>( arg.type ) ),
+			alloc,
+			true ),
+		  children[ 1 ] );
+		++fn_arg;
+	}
+
+	//To codegen block
+	auto &basicBlock = children[ 2 ][ "children" ];
+	for ( int i = 1; i < basicBlock.size() - 1; i++ )
+	{
+		codegen( basicBlock[ i ] );
+	}
+
+	if ( !gotoJump.empty() )
+	{
+		for ( auto &entry : gotoJump )
+		{
+			for ( auto &goto_stmt : entry.second )
+			{
+				infoList->add_msg(
+				  MSG_TYPE_ERROR,
+				  fmt( "use of undeclared label `", entry.first, "`" ),
+				  goto_stmt.second );
+			}
+		}
+		HALT();
+	}
+
+	// the implicit return is at the closing brace
+	if ( TheDebugInfo ) Builder.SetCurrentDebugLocation( TheDebugInfo->location( children[ 2 ], true ) );
+
+	auto ret_ty = TypeView( std::make_shared<QualifiedType>( type ) ).next();
+	AllocaInst *retValue;
+	LoadInst *retLoad;
+	if ( !ret_ty->is<mty::Void>() && ( name != "main" || !ret_ty->is<mty::Integer>() ) )
+	{
+		retValue = Builder.CreateAlloca( ret_ty->type );
+		retLoad = Builder.CreateLoad( retValue );
+		retValue->setName( "retVal" );
+	}
+
+	if ( name != "main" )
+	{
+		if ( !ret_ty->is<mty::Void>() )
+		{
+			abi::emit_return( fn_type->abi_info(), retLoad );
+		}
+		else
+		{
+			Builder.CreateRet( nullptr );
+		}
+	}
+	else
+	{
+		if ( ret_ty->is<mty::Integer>() )
+		{
+			Builder.CreateRet( Constant::getIntegerValue( ret_ty->type, APInt( 32, 0, false ) ) );
+		}
+		else if ( !ret_ty->is<mty::Void>() )
+		{
+			abi::emit_return( fn_type->abi_info(), retLoad );
+		}
+		else
+		{
+			Builder.CreateRet( nullptr );
+		}
+	}
+
+	if ( TheDebugInfo )
+	{
+		Builder.SetCurrentDebugLocation( DebugLoc() );
+		TheDebugInfo->end_function();
+	}
+
+	std::string fn_err;
+	raw_string_ostream fn_err_stream( fn_err );
+	if ( verifyFunction( *fn, &fn_err_stream ) )
+	{
+		fn_err_stream.flush();
+		TheModule->print( errs(), nullptr );
+		INTERNAL_ERROR( fmt( "\nLLVM Verify Function Failed:\n", fn_err ) );
+	}
+
+	//   dbg( symTable );
+	symTable.pop();
+}
 
 JumpTable<NodeHandler> handlers = {
 	{ "function_definition", pack_fn<VoidType, VoidType>( []( Json::Value &node, VoidType const & ) -> VoidType {
-		  Json::Value &children = node[ "children" ];
-
-		  auto declspec = get<DeclarationSpecifiers>( codegen( children[ 0 ], true ) );
-
-		  if ( declspec.has_attribute( SC_TYPEDEF ) )
-		  {
-			  infoList->add_msg( MSG_TYPE_ERROR, "function definition declared `typedef`", children[ 0 ] );
-			  HALT();
-		  }
-		  if ( declspec.has_attribute( SC_REGISTER ) || declspec.has_attribute( SC_AUTO ) )
-		  {
-			  infoList->add_msg( MSG_TYPE_ERROR, "illegal storage class on function", children[ 0 ] );
-			  HALT();
-		  }
-
-		  auto builder = declspec.into_type_builder(
-			children[ 0 ][ "type" ].asString() == "empty_declaration_specifiers" ? children[ 1 ] : children[ 0 ] );
-
-		  auto decl = get<QualifiedDecl>( codegen( children[ 1 ], &builder ) );
-		  auto type = decl.type;
-		  auto name = decl.name.unwrap();
-
-		  dbg( "=== Function ", name, " ===" );
-
-		  if ( !type.is<mty::Function>() )
-		  {
-			  infoList->add_msg( MSG_TYPE_ERROR, "expected a function defination", children[ 0 ] );
-			  HALT();
-		  }
-
-		  auto fn_type = type.as<mty::Function>();
-		  int errors = 0;
-
-		  for ( auto &arg : fn_type->args )
-		  {
-			  if ( !arg.type->is_valid_parameter_type() )
-			  {
-				  if ( !arg.type->is_complete() )
-				  {
-					  infoList->add_msg(
-						MSG_TYPE_ERROR,
-						fmt( "variable of incomplete type `", arg.type, "` cannot be used as function parameter" ),
-						node );
-					  errors++;
-				  }
-				  else
-				  {
-					  // checked already
-					  INTERNAL_ERROR();
-				  }
-			  }
-		  }
-
-		  if ( errors ) HALT();
-
-		  if ( auto sym = symTable.find_in_scope( name ) )
-		  {
-			  if ( sym->is_type() )
-			  {
-				  infoList->add_msg(
-					MSG_TYPE_ERROR,
-					fmt( "redefination of `", name, "` as different kind of symbol" ),
-					node );
-				  HALT();
-			  }
-			  auto val = sym->as_value();
-			  auto view = TypeView( std::make_shared<QualifiedType>( type ) );
-			  if ( !val.get_type().is_same( view ) )
-			  {
-				  infoList->add_msg(
-					MSG_TYPE_ERROR,
-					fmt( "forward declaration of `", name, "` conflicts" ),
-					node );
-				  HALT();
-			  }
-		  }
-
-		  auto fn = TheModule->getFunction( name );
-
-		  if ( !fn )
-		  {
-			  if ( !( fn = Function::Create(
-						static_cast<FunctionType *>( fn_type->type ),
-						Function::ExternalLinkage, name, TheModule.get() ) ) )
-			  {
-				  INTERNAL_ERROR();
-			  }
-		  }
-
-		  gotoJump.clear();
-		  labelJump.clear();
-
-		  auto func = QualifiedValue(
-			std::make_shared<QualifiedType>( type ), fn, false );
-
-		  symTable.insert(
-			name,
-			func,
-			children[ 1 ] );
-
-		  currentFunction = std::make_shared<QualifiedValue>( func );
-		  funcName = name;
-		  BasicBlock *BB = BasicBlock::Create( TheContext, "entry", fn );
-		  Builder.SetInsertPoint( BB );
-
-		  symTable.push();
-
-		  auto fn_arg = fn->arg_begin();
-		  for ( auto &arg : fn_type->args )
-		  {
-			  if ( arg.name.is_none() )
-			  {
-				  infoList->add_msg(
-					MSG_TYPE_ERROR,
-					fmt( "function parameter name omitted" ),
-					children[ 1 ] );
-				  HALT();
-			  }
-			  auto &name = arg.name.unwrap();
-			  auto alloc = Builder.CreateAlloca( arg.type->type, 0, name );
-			  Builder.CreateStore( fn_arg, alloc );
-			  symTable.insert_if(
-				name,
-				QualifiedValue(
-				  std::make_shared<QualifiedType>( arg.type ),
-				  alloc,
-				  true ),
-				children[ 1 ] );
-			  ++fn_arg;
-		  }
-
-		  //To codegen block
-		  auto &basicBlock = children[ 2 ][ "children" ];
-		  for ( int i = 1; i < basicBlock.size() - 1; i++ )
-		  {
-			  codegen( basicBlock[ i ] );
-		  }
-
-		  if ( !gotoJump.empty() )
-		  {
-			  for ( auto &entry : gotoJump )
-			  {
-				  for ( auto &goto_stmt : entry.second )
-				  {
-					  infoList->add_msg(
-						MSG_TYPE_ERROR,
-						fmt( "use of undeclared label `", entry.first, "`" ),
-						goto_stmt.second );
-				  }
-			  }
-			  HALT();
-		  }
-
-		  auto ret_ty = TypeView( std::make_shared<QualifiedType>( type ) ).next();
-		  AllocaInst *retValue;
-		  LoadInst *retLoad;
-		  if ( !ret_ty->is<mty::Void>() && ( name != "main" || !ret_ty->is<mty::Integer>() ) )
-		  {
-			  retValue = Builder.CreateAlloca( ret_ty->type );
-			  retLoad = Builder.CreateLoad( retValue );
-			  retValue->setName( "retVal" );
-		  }
-
-		  if ( name != "main" )
-		  {
-			  if ( !ret_ty->is<mty::Void>() )
-			  {
-				  Builder.CreateRet( retLoad );
-			  }
-			  else
-			  {
-				  Builder.CreateRet( nullptr );
-			  }
-		  }
-		  else
-		  {
-			  if ( ret_ty->is<mty::Integer>() )
-			  {
-				  Builder.CreateRet( Constant::getIntegerValue( ret_ty->type, APInt( 32, 0, false ) ) );
-			  }
-			  else if ( !ret_ty->is<mty::Void>() )
-			  {
-				  Builder.CreateRet( retLoad );
-			  }
-			  else
-			  {
-				  Builder.CreateRet( nullptr );
-			  }
-		  }
-
-		  std::string fn_err;
-		  raw_string_ostream fn_err_stream( fn_err );
-		  if ( verifyFunction( *fn, &fn_err_stream ) )
-		  {
-			  fn_err_stream.flush();
-			  TheModule->print( errs(), nullptr );
-			  INTERNAL_ERROR( fmt( "\nLLVM Verify Function Failed:\n", fn_err ) );
-		  }
-
-		  //   dbg( symTable );
-		  symTable.pop();
-
+		  define_function( declare_function( node ) );
 		  return VoidType{};
 	  } ) }
 };
@@ -241,6 +323,7 @@ AstType codegen( Json::Value &node, const ArgsType &arg )
 
 	if ( handlers.find( type ) != handlers.end() )
 	{
+		LocationScope loc( node );
 		auto res = handlers[ type ]( node, arg );
 		if ( stack_trace )
 		{
@@ -254,15 +337,64 @@ AstType codegen( Json::Value &node, const ArgsType &arg )
 	}
 }
 
-char *gen_llvm_ir_cxx( const char *ast_json )
+// hands the printed module to the frontend in pieces instead of one string
+class sink_ostream : public raw_ostream
+{
+	ir_sink sink;
+	void *ctx;
+	uint64_t pos = 0;
+
+	void write_impl( const char *ptr, size_t size ) override
+	{
+		sink( ctx, ptr, size );
+		pos += size;
+	}
+	uint64_t current_pos() const override
+	{
+		return pos;
+	}
+
+public:
+	sink_ostream( ir_sink sink, void *ctx ) :
+	  sink( sink ),
+	  ctx( ctx )
+	{
+		SetBufferSize( 1 << 16 );
+	}
+	~sink_ostream() override
+	{
+		flush();
+	}
+};
+
+void gen_llvm_ir_cxx( const char *prefix_json, const char *ast_json, const char *source, ir_sink sink, void *ctx )
 {
 	Json::Reader reader;
+	Json::Value prefix;
 	Json::Value root;
 
 	dbg( "enter ir-gen" );
 
 	// init
+	if ( !TheTargetInfo )
+	{
+		std::string err;
+		TheTargetInfo = TargetInfo::create( targetTriple, err );
+		if ( !TheTargetInfo )
+		{
+			infoList->add_msg( MSG_TYPE_ERROR, err );
+			HALT();
+		}
+	}
+	if ( compileOptions.xray_instrument )
+	{
+		xrayAlways = load_xray_list( compileOptions.xray_always );
+		xrayNever = load_xray_list( compileOptions.xray_never );
+	}
+	TheDebugInfo = nullptr;
 	TheModule = make_unique<Module>( "asd", TheContext );
+	TheModule->setTargetTriple( TheTargetInfo->triple );
+	TheModule->setDataLayout( TheTargetInfo->layout );
 	TheDataLayout = make_unique<DataLayout>( TheModule.get() );
 	currentFunction = nullptr;
 	funcName = "";
@@ -272,7 +404,8 @@ char *gen_llvm_ir_cxx( const char *ast_json )
 	dbg( "parsing ast" );
 
 	// finish
-	if ( !reader.parse( ast_json, root ) )
+	if ( !reader.parse( ast_json, root ) ||
+		 ( prefix_json && !reader.parse( prefix_json, prefix ) ) )
 	{
 		INTERNAL_ERROR( fmt( "jsoncpp failed to parse ast.json" ) );
 	}
@@ -305,9 +438,53 @@ char *gen_llvm_ir_cxx( const char *ast_json )
 
 	try
 	{
-		for ( auto i = 0; i < root.size(); ++i )
+		// declarations of a precompiled header, their diagnostics were
+		// reported when it was built and refer to text we do not have
+		// drop each subtree once generated, the module is all we need from here
+		for ( auto i = 0; i < prefix.size(); ++i )
+		{
+			codegen( prefix[ i ] );
+			prefix[ i ] = Json::Value();
+		}
+		infoList->clear();
+
+		// remarks are reported at the lines of the debug info, positions
+		// of the header refer to text we do not have either
+		auto remarks = compileOptions.rpass || compileOptions.rpass_missed ||
+					   compileOptions.rpass_analysis || compileOptions.save_opt_record ||
+					   compileOptions.mca_report;
+		if ( compileOptions.debug_info || compileOptions.profile_sample_use || remarks )
+		{
+			TheDebugInfo = make_unique<DebugInfo>( *TheModule, source );
+		}
+
+		if ( compileOptions.irgen_jobs > 1 )
+		{
+			// every prototype and global is in place before the first body,
+			// so the bodies no longer depend on each other
+			std::vector<FunctionDefinition> defs;
+			symTable.start_journal();
+			for ( auto i = 0; i < root.size(); ++i )
+			{
+				if ( root[ i ][ "type" ].asString() == "function_definition" )
+				{
+					defs.push_back( declare_function( root[ i ] ) );
+				}
+				else
+				{
+					codegen( root[ i ] );
+					root[ i ] = Json::Value();
+				}
+			}
+			define_functions( defs, compileOptions.irgen_jobs, define_function );
+		}
+		else
 		{
-			codegen( root[ i ] );
+			for ( auto i = 0; i < root.size(); ++i )
+			{
+				codegen( root[ i ] );
+				root[ i ] = Json::Value();
+			}
 		}
 	}
 	catch ( std::exception &_ )
@@ -322,6 +499,10 @@ char *gen_llvm_ir_cxx( const char *ast_json )
 	globObjects.pop();
 	symTable.pop();
 
+	define_workshare_runtime();
+	TheTargetInfo->set_alignments( *TheModule );
+	if ( TheDebugInfo ) TheDebugInfo->finalize();
+
 	if ( is_debug_mode )
 	{
 		TheModule->print( errs(), nullptr );
@@ -336,28 +517,21 @@ char *gen_llvm_ir_cxx( const char *ast_json )
 		INTERNAL_ERROR( fmt( "\nLLVM Verify Module Failed:\n", module_err ) );
 	}
 
-	std::string cxx_ir;
-	raw_string_ostream str_stream( cxx_ir );
-	TheModule->print( str_stream, nullptr );
-
-	auto ir = new char[ cxx_ir.length() + 1 ];
-	memcpy( ir, cxx_ir.c_str(), cxx_ir.length() + 1 );
-
-	return ir;
+	if ( sink )
+	{
+		sink_ostream stream( sink, ctx );
+		TheModule->print( stream, nullptr );
+	}
 }
 
 extern "C" {
-char *gen_llvm_ir( const char *ast_json )
+int gen_llvm_ir( const char *prefix_json, const char *ast_json, const char *source, ir_sink sink, void *ctx )
 {
-	char *val = nullptr;
+	int val = 1;
 	secure_exec( [&] {
-		val = gen_llvm_ir_cxx( ast_json );
+		gen_llvm_ir_cxx( prefix_json, ast_json, source, sink, ctx );
+		val = 0;
 	} );
 	return val;
 }
-
-void free_llvm_ir( char *ir )
-{
-	delete ir;
-}
 }
\ No newline at end of file
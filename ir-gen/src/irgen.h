@@ -1,9 +1,15 @@
 #pragma once
 
+#include <cstddef>
+
 #include "msglist.h"
 
 extern "C" {
 
-char *gen_llvm_ir( const char *ast_json );
-void free_llvm_ir( char *ir );
+// receives the textual ir piece by piece
+typedef void ( *ir_sink )( void *ctx, const char *chunk, size_t len );
+
+// generates TheModule from the ast of the preprocessed `source`,
+// `sink` may be null when the text is not needed
+int gen_llvm_ir( const char *prefix_json, const char *ast_json, const char *source, ir_sink sink, void *ctx );
 }
\ No newline at end of file
@@ -1,36 +1,158 @@
 #include "common.h"
 #include "global.h"
+#include "mca.h"
+#include "remarks.h"
+#include "target.h"
 
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/ProfileData/SampleProfReader.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Instrumentation.h"
+#include "llvm/Transforms/Utils.h"
 
-static int irc_into_obj_cxx(const char *out_file)
+// instruments TheModule for -fprofile-generate, or attaches the branch
+// weights and entry counts of -fprofile-use or -fprofile-sample-use
+// before codegen sees it
+static int apply_profile()
 {
-    auto triple = sys::getDefaultTargetTriple();
-    TheModule->setTargetTriple(triple);
+    legacy::PassManager pass;
+
+    if (auto dir = compileOptions.profile_generate)
+    {
+        InstrProfOptions options;
+        options.InstrProfileOutput = *dir ? fmt(dir, "/default_%m.profraw") : "default_%m.profraw";
+        options.DoCounterPromotion = true;
+        pass.add(createPGOInstrumentationGenLegacyPass());
+        pass.add(createInstrProfilingLegacyPass(options));
+    }
+    else if (auto file = compileOptions.profile_use)
+    {
+        // a bad profile is a fatal llvm diagnostic, check it here first
+        auto reader = IndexedInstrProfReader::create(file);
+        if (!reader)
+        {
+            infoList->add_msg(MSG_TYPE_ERROR, fmt("cannot use profile ", file, ": ", toString(reader.takeError())));
+            return 1;
+        }
+        pass.add(createPGOInstrumentationUseLegacyPass(file));
+    }
+    else if (auto file = compileOptions.profile_sample_use)
+    {
+        auto reader = sampleprof::SampleProfileReader::create(file, TheContext);
+        if (!reader)
+        {
+            infoList->add_msg(MSG_TYPE_ERROR, fmt("cannot use sample profile ", file, ": ", reader.getError().message()));
+            return 1;
+        }
+        for (auto &fn : *TheModule)
+        {
+            if (!fn.isDeclaration()) fn.addFnAttr("use-sample-profile");
+        }
+        // samples are matched to the line offsets ir-gen recorded, the
+        // discriminators tell apart the blocks that share a line
+        pass.add(createAddDiscriminatorsPass());
+        pass.add(createSampleProfileLoaderPass(file));
+    }
+    else
+    {
+        return 0;
+    }
+
+    pass.run(*TheModule);
+    return 0;
+}
+
+// splits TheModule into `jobs` parts, each compiled on a thread of its own
+// with its own context and target machine, then merges the objects into
+// `out_file` with a relocatable link
+static int emit_parts(const char *out_file, int jobs)
+{
+    auto ld = sys::findProgramByName("ld");
+    if (!ld)
+    {
+        infoList->add_msg(MSG_TYPE_ERROR, fmt("parallel codegen needs `ld` to combine objects: ", ld.getError().message()));
+        return 1;
+    }
+
+    std::vector<std::string> parts;
+    std::vector<std::unique_ptr<raw_fd_ostream>> streams;
+    std::vector<raw_pwrite_stream *> outs;
+    auto remove_parts = [&] {
+        streams.clear();
+        for (auto &part : parts) sys::fs::remove(part);
+    };
+
+    for (auto i = 0; i < jobs; ++i)
+    {
+        std::error_code errc;
+        parts.push_back(fmt(out_file, ".part", i, ".o"));
+        streams.emplace_back(new raw_fd_ostream(parts.back(), errc, sys::fs::F_None));
+        if (errc)
+        {
+            infoList->add_msg(MSG_TYPE_ERROR, fmt("Could not open file: ", errc.message()));
+            remove_parts();
+            return 1;
+        }
+        outs.push_back(streams.back().get());
+    }
 
+    // locals stay local: everything referring to one is kept in its part,
+    // otherwise they would be exported and clash with other objects
+    splitCodeGen(std::move(TheModule), outs, {}, [&] {
+        return std::unique_ptr<TargetMachine>(TheTargetInfo->create_machine());
+    }, TargetMachine::CGFT_ObjectFile, /*PreserveLocals=*/true);
+    streams.clear();
+
+    std::vector<StringRef> args = { *ld, "-r", "-o", out_file };
+    for (auto &part : parts) args.push_back(part);
     std::string err;
-    auto target = TargetRegistry::lookupTarget( triple, err);
+    auto status = sys::ExecuteAndWait(*ld, args, None, {}, 0, 0, &err);
+    remove_parts();
 
-    if (!target)
+    if (status != 0)
     {
-        infoList->add_msg(MSG_TYPE_ERROR, err);
+        infoList->add_msg(MSG_TYPE_ERROR, fmt("could not combine the objects of parallel codegen: ",
+                                              err.empty() ? fmt("ld exited with ", status) : err));
         return 1;
     }
+    return 0;
+}
+
+static int irc_into_file_cxx(const char *out_file, const char *record_file,
+                             TargetMachine::CodeGenFileType file_type)
+{
+    // the parts of parallel codegen have contexts of their own, their
+    // remarks are neither reported nor recorded
+    setup_remarks();
+    RemarkRecord record(record_file);
+
+    if (apply_profile()) return 1;
 
-    auto cpu = "generic";
-    auto features = "";
+    if (compileOptions.mca_report) mca_report(*TheModule);
 
-    TargetOptions opt;
-    auto rm = Optional<Reloc::Model>();
-    auto machine = target->createTargetMachine( triple, cpu, features, opt, rm );
+    // ir generation already set the triple and data layout of TheModule,
+    // the host linker only combines objects for the host
+    auto jobs = compileOptions.codegen_jobs;
+    if ( jobs > 1 && file_type == TargetMachine::CGFT_ObjectFile &&
+         TheTargetInfo->triple == sys::getDefaultTargetTriple() )
+    {
+        return emit_parts(out_file, jobs);
+    }
 
-    TheModule->setDataLayout( machine->createDataLayout() );
+    std::unique_ptr<TargetMachine> machine(TheTargetInfo->create_machine());
+    // the loop comments make the listing readable
+    machine->Options.MCOptions.AsmVerbose = true;
 
     std::error_code errc;
     raw_fd_ostream dest( out_file, errc, sys::fs::F_None );
@@ -42,7 +164,6 @@ static int irc_into_obj_cxx(const char *out_file)
     }
 
     legacy::PassManager pass;
-    auto file_type = TargetMachine::CGFT_ObjectFile;
 
     if ( machine->addPassesToEmitFile( pass, dest, nullptr, file_type ) )
     {
@@ -56,13 +177,81 @@ static int irc_into_obj_cxx(const char *out_file)
     return 0;
 }
 
+static int irc_run_cxx(int argc, const char **argv, int *exit_code)
+{
+    auto report = [](Error err) {
+        infoList->add_msg(MSG_TYPE_ERROR, fmt("jit: ", toString(std::move(err))));
+        return 1;
+    };
+
+    auto jtmb = orc::JITTargetMachineBuilder::detectHost();
+    if (!jtmb) return report(jtmb.takeError());
+
+    auto layout = jtmb->getDefaultDataLayoutForTarget();
+    if (!layout) return report(layout.takeError());
+
+    auto jit = orc::LLJIT::Create(std::move(*jtmb), *layout);
+    if (!jit) return report(jit.takeError());
+
+    // the program registers atexit handlers pointing into the jitted code,
+    // they run when mcc exits: the jit is deliberately never freed
+    auto lljit = jit->release();
+
+    // resolve everything we did not define (libc and friends) against the host process
+    auto host = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(*layout);
+    if (!host) return report(host.takeError());
+    lljit->getMainJITDylib().setGenerator(std::move(*host));
+
+    TheModule->setTargetTriple(lljit->getTargetTriple().str());
+    TheModule->setDataLayout(*layout);
+
+    // TheContext has static storage, this context handle is never released
+    // so the jit will not try to free it.
+    static auto ctx = new orc::ThreadSafeContext(std::unique_ptr<LLVMContext>(&TheContext));
+    if (auto err = lljit->addIRModule(orc::ThreadSafeModule(std::move(TheModule), *ctx)))
+    {
+        return report(std::move(err));
+    }
+
+    auto main_sym = lljit->lookup("main");
+    if (!main_sym) return report(main_sym.takeError());
+
+    if (auto err = lljit->runConstructors()) return report(std::move(err));
+
+    using MainFn = int (*)(int, const char **);
+    auto main_fn = reinterpret_cast<MainFn>(static_cast<uintptr_t>(main_sym->getAddress()));
+    *exit_code = main_fn(argc, argv);
+
+    if (auto err = lljit->runDestructors()) return report(std::move(err));
+
+    return 0;
+}
+
 extern "C" {
 
-int irc_into_obj(const char *out_file)
+int irc_into_obj(const char *out_file, const char *record_file)
+{
+    int val = 1;
+    secure_exec([&]{
+        val = irc_into_file_cxx( out_file, record_file, TargetMachine::CGFT_ObjectFile );
+    });
+    return val;
+}
+
+int irc_into_asm(const char *out_file, const char *record_file)
+{
+    int val = 1;
+    secure_exec([&]{
+        val = irc_into_file_cxx( out_file, record_file, TargetMachine::CGFT_AssemblyFile );
+    });
+    return val;
+}
+
+int irc_run(int argc, const char **argv, int *exit_code)
 {
     int val = 1;
     secure_exec([&]{
-        val = irc_into_obj_cxx( out_file );
+        val = irc_run_cxx( argc, argv, exit_code );
     });
     return val;
 }
@@ -2,6 +2,10 @@
 
 extern "C" {
 
-int irc_into_obj(const char *out_file);
+// `record_file` receives the optimization record of -fsave-optimization-record
+int irc_into_obj(const char *out_file, const char *record_file);
+int irc_into_asm(const char *out_file, const char *record_file);
+
+int irc_run(int argc, const char **argv, int *exit_code);
 
 }
\ No newline at end of file
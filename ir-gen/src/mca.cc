@@ -0,0 +1,389 @@
+#include "mca.h"
+#include "debuginfo.h"
+#include "global.h"
+#include "target.h"
+
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCInstrAnalysis.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/MC/MCObjectFileInfo.h"
+#include "llvm/MC/MCParser/MCAsmParser.h"
+#include "llvm/MC/MCParser/MCTargetAsmParser.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/MC/MCStreamer.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MCA/Context.h"
+#include "llvm/MCA/HWEventListener.h"
+#include "llvm/MCA/InstrBuilder.h"
+#include "llvm/MCA/SourceMgr.h"
+#include "llvm/MCA/Support.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+// iterations of a region simulated, as many as llvm-mca runs by default
+static constexpr unsigned ITERATIONS = 100;
+
+// instructions of a region, with the first source line found in it
+struct Region
+{
+	std::string function;
+	std::string header;  // label of the loop header, empty for a whole function
+	std::vector<std::string> insts;
+	std::string file;
+	unsigned line = 0, col = 0;
+};
+
+// collects the instructions the asm parser reads, nothing is emitted
+class InstCollector final : public MCStreamer
+{
+public:
+	std::vector<MCInst> insts;
+
+	InstCollector( MCContext &ctx ) :
+	  MCStreamer( ctx )
+	{
+	}
+
+	void EmitInstruction( const MCInst &inst, const MCSubtargetInfo &, bool ) override
+	{
+		insts.push_back( inst );
+	}
+	bool EmitSymbolAttribute( MCSymbol *, MCSymbolAttr ) override { return true; }
+	void EmitCommonSymbol( MCSymbol *, uint64_t, unsigned ) override {}
+	void EmitZerofill( MCSection *, MCSymbol *, uint64_t, unsigned, SMLoc ) override {}
+	void EmitGPRel32Value( const MCExpr * ) override {}
+	void BeginCOFFSymbolDef( const MCSymbol * ) override {}
+	void EmitCOFFSymbolStorageClass( int ) override {}
+	void EmitCOFFSymbolType( int ) override {}
+	void EndCOFFSymbolDef() override {}
+};
+
+// what the report needs from the simulation
+class PressureListener final : public mca::HWEventListener
+{
+	const MCSchedModel &model;
+	SmallVector<uint64_t, 16> masks;
+	unsigned cycle = 0;
+	std::vector<unsigned> dispatched;
+
+public:
+	std::vector<double> pressure;  // cycles per resource kind
+	std::vector<double> wait;	   // cycles from dispatch to issue per instruction
+	unsigned retired = 0;
+
+	PressureListener( const MCSchedModel &model, unsigned size ) :
+	  model( model ),
+	  masks( model.getNumProcResourceKinds() ),
+	  dispatched( size ),
+	  pressure( model.getNumProcResourceKinds() ),
+	  wait( size )
+	{
+		mca::computeProcResourceMasks( model, masks );
+	}
+
+	void onCycleEnd() override
+	{
+		++cycle;
+	}
+
+	void onEvent( const mca::HWInstructionEvent &event ) override
+	{
+		auto index = event.IR.getSourceIndex() % dispatched.size();
+		switch ( event.Type )
+		{
+		case mca::HWInstructionEvent::Dispatched: dispatched[ index ] = cycle; break;
+		case mca::HWInstructionEvent::Retired: ++retired; break;
+		case mca::HWInstructionEvent::Issued:
+		{
+			wait[ index ] += cycle - dispatched[ index ];
+			auto &issued = static_cast<const mca::HWInstructionIssuedEvent &>( event );
+			for ( auto &use : issued.UsedResources )
+			{
+				auto kind = std::find( masks.begin(), masks.end(), use.first.first ) - masks.begin();
+				if ( kind == masks.size() ) continue;
+				pressure[ kind ] += double( use.second.getNumerator() ) / use.second.getDenominator();
+			}
+			break;
+		}
+		}
+	}
+};
+
+// `.LBB0_2:` on elf, `LBB0_2:` on darwin
+static bool is_block_label( StringRef code )
+{
+	return ( code.startswith( ".LBB" ) || code.startswith( "LBB" ) ) && code.endswith( ":" );
+}
+
+// `BB0_2`, as loop comments name the block
+static std::string block_name( StringRef code )
+{
+	return code.ltrim( '.' ).ltrim( 'L' ).drop_back().str();
+}
+
+// the header a verbose loop comment refers to
+static std::string loop_header( StringRef line )
+{
+	StringRef key = "in Loop: Header=";
+	auto at = line.find( key );
+	if ( at == StringRef::npos ) return "";
+	return line.drop_front( at + key.size() ).take_until( []( char c ) { return c == ' '; } ).str();
+}
+
+// splits verbose assembly into regions, by the loop comments of the asm printer
+static std::vector<Region> find_regions( StringRef text, StringRef comment, const std::set<std::string> &hot )
+{
+	SmallVector<StringRef, 0> lines;
+	text.split( lines, '\n' );
+
+	// innermost loops are marked at their headers, which rotated loops lay out last
+	std::set<std::string> inner;
+	std::string label;
+	for ( auto line : lines )
+	{
+		auto code = line.split( comment ).first.trim();
+		if ( is_block_label( code ) ) label = block_name( code );
+		if ( line.contains( "This Inner Loop Header" ) ) inner.insert( label );
+	}
+
+	std::map<unsigned, std::string> file_names;
+	std::map<std::pair<std::string, std::string>, Region> regions;
+	auto get_region = [&]( const std::string &function, const std::string &header ) {
+		auto &region = regions[ { function, header } ];
+		region.function = function;
+		region.header = header;
+		return &region;
+	};
+
+	std::string function;
+	Region *current = nullptr;
+	for ( auto line : lines )
+	{
+		line = line.trim();
+		auto code = line.split( comment ).first.rtrim();
+
+		if ( code.startswith( ".file" ) )
+		{
+			// `.file 1 "a.c"` or `.file 1 "dir" "a.c"`
+			unsigned id;
+			auto rest = code.drop_front( 5 ).ltrim();
+			if ( rest.consumeInteger( 10, id ) || !rest.endswith( "\"" ) ) continue;
+			rest = rest.drop_back();
+			file_names[ id ] = rest.drop_front( rest.rfind( '"' ) + 1 ).str();
+			continue;
+		}
+
+		auto is_block = is_block_label( code ) || code.empty() && line.contains( "%bb." );
+		if ( is_block )
+		{
+			label = is_block_label( code ) ? block_name( code ) : "";
+			current = hot.count( function ) ? get_region( function, "" ) : nullptr;
+		}
+		else if ( code.endswith( ":" ) && !code.startswith( "." ) )
+		{
+			// a function starts, it is a region of its own if it is hot
+			function = code.drop_back().str();
+			current = hot.count( function ) ? get_region( function, "" ) : nullptr;
+			continue;
+		}
+
+		// loop comments follow the label of their block
+		auto header = line.contains( "This Inner Loop Header" ) ? label : loop_header( line );
+		if ( !header.empty() && inner.count( header ) ) current = get_region( function, header );
+
+		if ( is_block || code.empty() || !current ) continue;
+		if ( code.startswith( ".loc" ) )
+		{
+			unsigned id;
+			auto rest = code.drop_front( 4 ).ltrim();
+			if ( !current->line && !rest.consumeInteger( 10, id ) &&
+				 !( rest = rest.ltrim() ).consumeInteger( 10, current->line ) )
+			{
+				rest.ltrim().consumeInteger( 10, current->col );
+				current->file = file_names[ id ];
+			}
+			continue;
+		}
+		if ( code.startswith( "." ) ) continue;
+		current->insts.push_back( code.str() );
+	}
+
+	std::vector<Region> res;
+	for ( auto &region : regions )
+	{
+		if ( !region.second.insts.empty() ) res.push_back( std::move( region.second ) );
+	}
+	return res;
+}
+
+static void report( const Region &region, const std::string &msg )
+{
+	auto what = region.header.empty() ? fmt( "function `", region.function, "`" )
+									  : fmt( "loop ", region.header, " in `", region.function, "`" );
+	auto text = fmt( "mca: ", what, ": ", msg );
+	std::size_t pos[ 4 ];
+	if ( TheDebugInfo && region.line && TheDebugInfo->find_position( region.file, region.line, region.col, pos ) )
+	{
+		infoList->add_msg( MSG_TYPE_REMARK, text, pos );
+	}
+	else
+	{
+		infoList->add_msg( MSG_TYPE_REMARK, text );
+	}
+}
+
+void mca_report( const Module &module )
+{
+	// codegen changes the ir it runs on, the report runs on a copy
+	auto copy = CloneModule( module );
+	std::unique_ptr<TargetMachine> machine( TheTargetInfo->create_machine() );
+	machine->Options.MCOptions.AsmVerbose = true;
+
+	SmallString<0> text;
+	{
+		raw_svector_ostream os( text );
+		legacy::PassManager pass;
+		if ( machine->addPassesToEmitFile( pass, os, nullptr, TargetMachine::CGFT_AssemblyFile ) )
+		{
+			infoList->add_msg( MSG_TYPE_WARNING, "mca: the target cannot emit assembly" );
+			return;
+		}
+		pass.run( *copy );
+	}
+
+	auto &triple = TheTargetInfo->triple;
+	auto target = &machine->getTarget();
+	std::unique_ptr<MCRegisterInfo> mri( target->createMCRegInfo( triple ) );
+	std::unique_ptr<MCAsmInfo> mai( target->createMCAsmInfo( *mri, triple ) );
+	std::unique_ptr<MCInstrInfo> mcii( target->createMCInstrInfo() );
+	std::unique_ptr<MCSubtargetInfo> sti(
+	  target->createMCSubtargetInfo( triple, machine->getTargetCPU(), machine->getTargetFeatureString() ) );
+	std::unique_ptr<MCInstrAnalysis> mcia( target->createMCInstrAnalysis( mcii.get() ) );
+	if ( !mcia )
+	{
+		infoList->add_msg( MSG_TYPE_WARNING, fmt( "mca: target `", triple, "` has no instruction analysis" ) );
+		return;
+	}
+	if ( !target->hasMCAsmParser() )
+	{
+		infoList->add_msg( MSG_TYPE_WARNING, fmt( "mca: target `", triple, "` cannot parse assembly" ) );
+		return;
+	}
+	auto &model = sti->getSchedModel();
+	if ( !model.hasInstrSchedModel() )
+	{
+		infoList->add_msg( MSG_TYPE_WARNING, fmt( "mca: cpu `", machine->getTargetCPU().str(), "` has no scheduling model" ) );
+		return;
+	}
+
+	std::set<std::string> hot;
+	for ( auto &fn : module )
+	{
+		auto prefix = fn.getSectionPrefix();
+		if ( !fn.isDeclaration() && prefix && *prefix == ".hot" ) hot.insert( fn.getName().str() );
+	}
+
+	for ( auto &region : find_regions( text, mai->getCommentString(), hot ) )
+	{
+		// parse the instructions of the region back, labels it jumps to are left undefined
+		std::string source;
+		for ( auto &inst : region.insts ) source += inst + "\n";
+
+		MCObjectFileInfo mofi;
+		MCContext ctx( mai.get(), mri.get(), &mofi );
+		mofi.InitMCObjectFileInfo( Triple( triple ), false, ctx );
+		SourceMgr srcmgr;
+		srcmgr.AddNewSourceBuffer( MemoryBuffer::getMemBufferCopy( source ), SMLoc() );
+		srcmgr.setDiagHandler( []( const SMDiagnostic &, void * ) {} );
+		InstCollector collector( ctx );
+		std::unique_ptr<MCAsmParser> parser( createMCAsmParser( srcmgr, ctx, collector, *mai ) );
+		MCTargetOptions options;
+		std::unique_ptr<MCTargetAsmParser> target_parser( target->createMCAsmParser( *sti, *parser, *mcii, options ) );
+		if ( !target_parser )
+		{
+			infoList->add_msg( MSG_TYPE_WARNING, fmt( "mca: target `", triple, "` cannot parse assembly" ) );
+			return;
+		}
+		parser->setTargetParser( *target_parser );
+		if ( parser->Run( false ) || collector.insts.empty() )
+		{
+			report( region, "cannot read back its assembly" );
+			continue;
+		}
+
+		mca::InstrBuilder builder( *sti, *mcii, *mri, *mcia );
+		std::vector<std::unique_ptr<mca::Instruction>> insts;
+		std::string err;
+		for ( auto &inst : collector.insts )
+		{
+			auto lowered = builder.createInstruction( inst );
+			if ( !lowered )
+			{
+				err = toString( lowered.takeError() );
+				break;
+			}
+			insts.push_back( std::move( *lowered ) );
+		}
+		if ( !err.empty() )
+		{
+			report( region, fmt( "cannot simulate: ", err ) );
+			continue;
+		}
+
+		mca::Context mca( *mri, *sti );
+		mca::PipelineOptions pipeline_options( 0, 0, 0, 0, true );
+		mca::SourceMgr insts_source( insts, ITERATIONS );
+		auto pipeline = mca.createDefaultPipeline( pipeline_options, builder, insts_source );
+		PressureListener listener( model, insts.size() );
+		pipeline->addEventListener( &listener );
+		auto cycles = pipeline->run();
+		if ( !cycles )
+		{
+			report( region, fmt( "cannot simulate: ", toString( cycles.takeError() ) ) );
+			continue;
+		}
+
+		std::ostringstream msg;
+		msg.precision( 2 );
+		msg << std::fixed << insts.size() << " instructions, "
+			<< double( *cycles ) / ITERATIONS << " cycles per iteration, ipc "
+			<< double( listener.retired ) / *cycles << ", on " << machine->getTargetCPU().str();
+
+		// resources busy at least a quarter of an iteration, busiest first
+		std::vector<std::pair<double, unsigned>> busy;
+		for ( unsigned kind = 1; kind < listener.pressure.size(); ++kind )
+		{
+			auto per_iteration = listener.pressure[ kind ] / ITERATIONS;
+			if ( per_iteration >= 0.25 ) busy.emplace_back( per_iteration, kind );
+		}
+		std::sort( busy.rbegin(), busy.rend() );
+		msg << "\n  resource pressure per iteration:";
+		for ( auto &res : busy ) msg << " " << model.getProcResource( res.second )->Name << " " << res.first;
+		if ( busy.empty() ) msg << " none";
+
+		// instructions that wait the longest to issue, on the critical dependency chain
+		// or stuck behind a busy port
+		std::vector<std::pair<double, unsigned>> waits;
+		for ( unsigned i = 0; i != listener.wait.size(); ++i )
+		{
+			waits.emplace_back( listener.wait[ i ] / ITERATIONS, i );
+		}
+		std::sort( waits.rbegin(), waits.rend() );
+		waits.resize( std::min<std::size_t>( waits.size(), 3 ) );
+		msg << "\n  longest waits to issue:";
+		for ( auto &wait : waits )
+		{
+			if ( wait.first < 1 ) break;
+			msg << "\n    " << wait.first << " cycles  ";
+			if ( collector.insts.size() == region.insts.size() )
+				msg << "`" << region.insts[ wait.second ] << "`";
+			else
+				msg << "instruction " << wait.second;
+		}
+		report( region, msg.str() );
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "common.h"
+
+// --mca-report: simulates the machine code of every innermost loop, and of
+// every `hot` function, on the pipeline of the selected cpu and reports the
+// throughput and the resource pressure as remarks at the loop's source line
+void mca_report( const Module &module );
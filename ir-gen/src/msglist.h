@@ -14,6 +14,7 @@ namespace ffi
 
 constexpr int MSG_TYPE_ERROR = 0;
 constexpr int MSG_TYPE_WARNING = 1;
+constexpr int MSG_TYPE_REMARK = 2;
 
 struct Msg final
 {
@@ -36,6 +37,15 @@ public:
 			pos[ i ] = cxx_pos[ i ].asUInt64();
 		}
 	}
+	Msg( int type, const std::string &cxx_msg,
+		 const std::size_t ( &cxx_pos )[ 4 ] ) :
+	  msg( (char *)malloc( sizeof( char ) * cxx_msg.length() + 1 ) ),
+	  type( type ),
+	  has_loc( true )
+	{
+		memcpy( msg, cxx_msg.c_str(), cxx_msg.length() + 1 );
+		memcpy( pos, cxx_pos, sizeof( pos ) );
+	}
 	Msg( int type, const std::string &cxx_msg ) :
 	  msg( (char *)malloc( sizeof( char ) * cxx_msg.length() + 1 ) ),
 	  type( type ),
@@ -12,7 +12,14 @@ static DeclarationSpecifiers handle_decl( Json::Value &node, bool has_def )
 		auto &child = children[ i ];
 		if ( !child.isObject() )
 		{
-			declspec.add_attribute( child[ 1 ].asCString(), child );
+			if ( child[ 0 ].asString() == "ATTRIBUTE" )
+			{
+				declspec.add_gnu_attribute( child[ 1 ].asString(), child );
+			}
+			else
+			{
+				declspec.add_attribute( child[ 1 ].asCString(), child );
+			}
 		}
 	}
 
@@ -178,7 +185,7 @@ static QualifiedDecl handle_function_array( Json::Value &node, QualifiedTypeBuil
 			args.clear();
 		}
 		builder->add_level( std::make_shared<mty::Function>(
-		  builder->get_type()->type, args, is_va_args ) );
+		  builder->get_type(), args, is_va_args ) );
 
 		if ( an != 0 )
 		{
@@ -446,6 +453,19 @@ int Declaration::reg()
 			  codegen( children[ 0 ], builder );
 			  return get<QualifiedDecl>( codegen( children[ 1 ], builder ) );
 		  } ) },
+		{ "attributed_declarator", pack_fn<QualifiedTypeBuilder *, QualifiedDecl>( []( Json::Value &node, QualifiedTypeBuilder *const &builder ) -> QualifiedDecl {
+			  // with arg = QualifiedTypeBuilder *
+			  auto &children = node[ "children" ];
+			  GnuAttributes attrs;
+			  for ( int i = 1; i < children.size(); ++i )
+			  {
+				  attrs.add( children[ i ][ 1 ].asString(), children[ i ] );
+			  }
+			  attrs.apply( *builder, node );
+			  auto decl = get<QualifiedDecl>( codegen( children[ 0 ], builder ) );
+			  decl.attrs.merge( attrs, node );
+			  return decl;
+		  } ) },
 		{ "abstract_declarator", pack_fn<QualifiedTypeBuilder *, QualifiedDecl>( []( Json::Value &node, QualifiedTypeBuilder *const &builder ) -> QualifiedDecl {
 			  auto &children = node[ "children" ];
 			  auto decl = codegen( children[ 0 ], builder );
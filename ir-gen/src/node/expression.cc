@@ -2,7 +2,7 @@
 
 static QualifiedValue size_of_type( const TypeView &type, Json::Value &ast )
 {
-	auto &value_type = TypeView::getLongTy( false );
+	auto &value_type = TypeView::getPtrDiffTy( false );
 	if ( !type->is_complete() )
 	{
 		infoList->add_msg(
@@ -17,11 +17,39 @@ static QualifiedValue size_of_type( const TypeView &type, Json::Value &ast )
 		value_type->type, APInt( value_type->as<mty::Integer>()->bits, uint64_t( bytes ), false ) ) );
 }
 
+// the type arithmetic is performed on, vectors operate on their elements
+static const mty::Qualified *scalar_type( const TypeView &type )
+{
+	if ( type->is<mty::Vector>() )
+	{
+		auto elem = type;
+		return elem.next().get();
+	}
+	return type.get();
+}
+
+// comparing vectors yields a vector of signed integers that are all ones where true
+static QualifiedValue compare_result( const TypeView &type, Value *cmp )
+{
+	if ( auto vec = type->as<mty::Vector>() )
+	{
+		auto bits = scalar_type( type )->type->getScalarSizeInBits();
+		auto builder = QualifiedTypeBuilder( std::make_shared<mty::Integer>( bits, true ) );
+		auto res_ty = builder
+						.add_level( std::make_shared<mty::Vector>( builder.get_type()->type, vec->len ) )
+						.build();
+		return QualifiedValue(
+		  TypeView( std::make_shared<QualifiedType>( res_ty ) ),
+		  Builder.CreateSExt( cmp, res_ty->type ) );
+	}
+	return QualifiedValue( TypeView::getBoolTy(), cmp );
+}
+
 static QualifiedValue pos( QualifiedValue &val, Json::Value &ast )
 {
 	if ( !val.is_rvalue() ) INTERNAL_ERROR();
 	auto &type = val.get_type();
-	if ( !type->is<mty::Arithmetic>() )
+	if ( !scalar_type( type )->is<mty::Arithmetic>() )
 	{
 		infoList->add_msg(
 		  MSG_TYPE_ERROR,
@@ -41,7 +69,7 @@ static QualifiedValue neg( QualifiedValue &val, Json::Value &ast )
 {
 	if ( !val.is_rvalue() ) INTERNAL_ERROR();
 	auto &type = val.get_type();
-	if ( !type->is<mty::Arithmetic>() )
+	if ( !scalar_type( type )->is<mty::Arithmetic>() )
 	{
 		infoList->add_msg(
 		  MSG_TYPE_ERROR,
@@ -49,7 +77,7 @@ static QualifiedValue neg( QualifiedValue &val, Json::Value &ast )
 		  ast );
 		HALT();
 	}
-	if ( type->is<mty::Integer>() )
+	if ( scalar_type( type )->is<mty::Integer>() )
 	{
 		return QualifiedValue( type, Builder.CreateNeg( val.get() ) );
 	}
@@ -63,7 +91,7 @@ static QualifiedValue flip( QualifiedValue &val, Json::Value &ast )
 {
 	if ( !val.is_rvalue() ) INTERNAL_ERROR();
 	auto &type = val.get_type();
-	if ( !type->is<mty::Integer>() )
+	if ( !scalar_type( type )->is<mty::Integer>() )
 	{
 		infoList->add_msg(
 		  MSG_TYPE_ERROR,
@@ -95,6 +123,30 @@ static QualifiedValue logical_not( QualifiedValue &val, Json::Value &ast )
 		  .get() ) );
 }
 
+// under -ffp-contract=on a product that feeds straight into a sum, i.e.
+// both come from the same expression, becomes llvm.fmuladd
+static Value *try_fmuladd( Value *lhs, Value *rhs, bool is_sub )
+{
+	if ( compileOptions.fp_contract != FP_CONTRACT_ON ) return nullptr;
+
+	auto is_product = []( Value *val ) {
+		auto mul = dyn_cast<BinaryOperator>( val );
+		return mul && mul->getOpcode() == Instruction::FMul && mul->use_empty();
+	};
+	auto fuse = [&]( Value *product, Value *addend, bool negate_product ) -> Value * {
+		auto mul = cast<BinaryOperator>( product );
+		Value *a = mul->getOperand( 0 ), *b = mul->getOperand( 1 );
+		mul->eraseFromParent();
+		if ( negate_product ) a = Builder.CreateFNeg( a );
+		auto fn = Intrinsic::getDeclaration( TheModule.get(), Intrinsic::fmuladd, { addend->getType() } );
+		return Builder.CreateCall( fn, { a, b, addend } );
+	};
+
+	if ( is_product( lhs ) ) return fuse( lhs, is_sub ? Builder.CreateFNeg( rhs ) : rhs, false );
+	if ( is_product( rhs ) ) return fuse( rhs, lhs, is_sub );
+	return nullptr;
+}
+
 static QualifiedValue add( QualifiedValue &lhs, QualifiedValue &rhs, Json::Value &ast )
 {
 	if ( lhs.get_type()->is<mty::Derefable>() && rhs.get_type()->is<mty::Integer>() )
@@ -109,10 +161,14 @@ static QualifiedValue add( QualifiedValue &lhs, QualifiedValue &rhs, Json::Value
 	{
 		QualifiedValue::cast_binary_expr( lhs.value( ast[ "children" ][ 0 ] ), rhs, ast );
 		auto &type = lhs.get_type();
-		if ( auto itype = type->as<mty::Integer>() )
+		if ( auto itype = scalar_type( type )->as<mty::Integer>() )
 		{
 			return QualifiedValue( type, Builder.CreateAdd( lhs.get(), rhs.get() ) );
 		}
+		else if ( auto val = try_fmuladd( lhs.get(), rhs.get(), false ) )
+		{
+			return QualifiedValue( type, val );
+		}
 		else
 		{
 			return QualifiedValue( type, Builder.CreateFAdd( lhs.get(), rhs.get() ) );
@@ -136,7 +192,8 @@ static QualifiedValue sub( QualifiedValue &lhs, QualifiedValue &rhs, Json::Value
 			auto diff = Builder.CreatePtrDiff(
 			  lhs.value( ast[ "children" ][ 0 ] ).get(),
 			  rhs.value( ast[ "children" ][ 2 ] ).get() );
-			return QualifiedValue( TypeView::getLongTy( true ), diff );
+			auto &diff_ty = TypeView::getPtrDiffTy( true );
+			return QualifiedValue( diff_ty, Builder.CreateSExtOrTrunc( diff, diff_ty->type ) );
 		}
 		else
 		{
@@ -151,10 +208,14 @@ static QualifiedValue sub( QualifiedValue &lhs, QualifiedValue &rhs, Json::Value
 	{
 		QualifiedValue::cast_binary_expr( lhs.value( ast[ "children" ][ 0 ] ), rhs, ast );
 		auto &type = lhs.get_type();
-		if ( auto itype = type->as<mty::Integer>() )
+		if ( auto itype = scalar_type( type )->as<mty::Integer>() )
 		{
 			return QualifiedValue( type, Builder.CreateSub( lhs.get(), rhs.get() ) );
 		}
+		else if ( auto val = try_fmuladd( lhs.get(), rhs.get(), true ) )
+		{
+			return QualifiedValue( type, val );
+		}
 		else
 		{
 			return QualifiedValue( type, Builder.CreateFSub( lhs.get(), rhs.get() ) );
@@ -173,7 +234,7 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 		{ "*", []( QualifiedValue &lhs, QualifiedValue &rhs, Json::Value &ast ) -> QualifiedValue {
 			 QualifiedValue::cast_binary_expr( lhs, rhs, ast );
 			 auto &type = lhs.get_type();
-			 if ( type->is<mty::Integer>() )
+			 if ( scalar_type( type )->is<mty::Integer>() )
 			 {
 				 return QualifiedValue( type, Builder.CreateMul( lhs.get(), rhs.get() ) );
 			 }
@@ -185,7 +246,7 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 		{ "/", []( QualifiedValue &lhs, QualifiedValue &rhs, Json::Value &ast ) -> QualifiedValue {
 			 QualifiedValue::cast_binary_expr( lhs, rhs, ast );
 			 auto &type = lhs.get_type();
-			 if ( auto itype = type->as<mty::Integer>() )
+			 if ( auto itype = scalar_type( type )->as<mty::Integer>() )
 			 {
 				 if ( itype->is_signed )
 				 {
@@ -204,7 +265,7 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 		{ "%", []( QualifiedValue &lhs, QualifiedValue &rhs, Json::Value &ast ) -> QualifiedValue {
 			 QualifiedValue::cast_binary_expr( lhs, rhs, ast );
 			 auto &type = lhs.get_type();
-			 if ( auto itype = type->as<mty::Integer>() )
+			 if ( auto itype = scalar_type( type )->as<mty::Integer>() )
 			 {
 				 if ( itype->is_signed )
 				 {
@@ -234,7 +295,7 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 		 } },
 		{ ">>", []( QualifiedValue &lhs, QualifiedValue &rhs, Json::Value &ast ) -> QualifiedValue {
 			 QualifiedValue::cast_binary_expr( lhs, rhs, ast, false );
-			 auto type = lhs.get_type()->as<mty::Integer>();
+			 auto type = scalar_type( lhs.get_type() )->as<mty::Integer>();
 			 if ( type->is_signed )
 			 {
 				 return QualifiedValue( lhs.get_type(), Builder.CreateAShr( lhs.get(), rhs.get() ) );
@@ -250,20 +311,20 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 			 if ( !QualifiedValue::cast_binary_ptr( lhs, rhs, ast ) )
 			 {
 				 QualifiedValue::cast_binary_expr( lhs, rhs, ast );
-				 if ( auto itype = lhs.get_type()->as<mty::Integer>() )
+				 if ( auto itype = scalar_type( lhs.get_type() )->as<mty::Integer>() )
 				 {
 					 if ( itype->is_signed )
 					 {
-						 return QualifiedValue( type, Builder.CreateICmpSLT( lhs.get(), rhs.get() ) );
+						 return compare_result( lhs.get_type(), Builder.CreateICmpSLT( lhs.get(), rhs.get() ) );
 					 }
 					 else
 					 {
-						 return QualifiedValue( type, Builder.CreateICmpULT( lhs.get(), rhs.get() ) );
+						 return compare_result( lhs.get_type(), Builder.CreateICmpULT( lhs.get(), rhs.get() ) );
 					 }
 				 }
 				 else
 				 {
-					 return QualifiedValue( type, Builder.CreateFCmpOLT( lhs.get(), rhs.get() ) );
+					 return compare_result( lhs.get_type(), Builder.CreateFCmpOLT( lhs.get(), rhs.get() ) );
 				 }
 			 }
 			 else
@@ -276,20 +337,20 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 			 if ( !QualifiedValue::cast_binary_ptr( lhs, rhs, ast ) )
 			 {
 				 QualifiedValue::cast_binary_expr( lhs, rhs, ast );
-				 if ( auto itype = lhs.get_type()->as<mty::Integer>() )
+				 if ( auto itype = scalar_type( lhs.get_type() )->as<mty::Integer>() )
 				 {
 					 if ( itype->is_signed )
 					 {
-						 return QualifiedValue( type, Builder.CreateICmpSGT( lhs.get(), rhs.get() ) );
+						 return compare_result( lhs.get_type(), Builder.CreateICmpSGT( lhs.get(), rhs.get() ) );
 					 }
 					 else
 					 {
-						 return QualifiedValue( type, Builder.CreateICmpUGT( lhs.get(), rhs.get() ) );
+						 return compare_result( lhs.get_type(), Builder.CreateICmpUGT( lhs.get(), rhs.get() ) );
 					 }
 				 }
 				 else
 				 {
-					 return QualifiedValue( type, Builder.CreateFCmpOGT( lhs.get(), rhs.get() ) );
+					 return compare_result( lhs.get_type(), Builder.CreateFCmpOGT( lhs.get(), rhs.get() ) );
 				 }
 			 }
 			 else
@@ -302,20 +363,20 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 			 if ( !QualifiedValue::cast_binary_ptr( lhs, rhs, ast ) )
 			 {
 				 QualifiedValue::cast_binary_expr( lhs, rhs, ast );
-				 if ( auto itype = lhs.get_type()->as<mty::Integer>() )
+				 if ( auto itype = scalar_type( lhs.get_type() )->as<mty::Integer>() )
 				 {
 					 if ( itype->is_signed )
 					 {
-						 return QualifiedValue( type, Builder.CreateICmpSLE( lhs.get(), rhs.get() ) );
+						 return compare_result( lhs.get_type(), Builder.CreateICmpSLE( lhs.get(), rhs.get() ) );
 					 }
 					 else
 					 {
-						 return QualifiedValue( type, Builder.CreateICmpULE( lhs.get(), rhs.get() ) );
+						 return compare_result( lhs.get_type(), Builder.CreateICmpULE( lhs.get(), rhs.get() ) );
 					 }
 				 }
 				 else
 				 {
-					 return QualifiedValue( type, Builder.CreateFCmpOLE( lhs.get(), rhs.get() ) );
+					 return compare_result( lhs.get_type(), Builder.CreateFCmpOLE( lhs.get(), rhs.get() ) );
 				 }
 			 }
 			 else
@@ -328,20 +389,20 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 			 if ( !QualifiedValue::cast_binary_ptr( lhs, rhs, ast ) )
 			 {
 				 QualifiedValue::cast_binary_expr( lhs, rhs, ast );
-				 if ( auto itype = lhs.get_type()->as<mty::Integer>() )
+				 if ( auto itype = scalar_type( lhs.get_type() )->as<mty::Integer>() )
 				 {
 					 if ( itype->is_signed )
 					 {
-						 return QualifiedValue( type, Builder.CreateICmpSGE( lhs.get(), rhs.get() ) );
+						 return compare_result( lhs.get_type(), Builder.CreateICmpSGE( lhs.get(), rhs.get() ) );
 					 }
 					 else
 					 {
-						 return QualifiedValue( type, Builder.CreateICmpUGE( lhs.get(), rhs.get() ) );
+						 return compare_result( lhs.get_type(), Builder.CreateICmpUGE( lhs.get(), rhs.get() ) );
 					 }
 				 }
 				 else
 				 {
-					 return QualifiedValue( type, Builder.CreateFCmpOGE( lhs.get(), rhs.get() ) );
+					 return compare_result( lhs.get_type(), Builder.CreateFCmpOGE( lhs.get(), rhs.get() ) );
 				 }
 			 }
 			 else
@@ -355,13 +416,13 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 			 if ( !QualifiedValue::cast_binary_ptr( lhs, rhs, ast, true ) )
 			 {
 				 QualifiedValue::cast_binary_expr( lhs, rhs, ast );
-				 if ( auto itype = lhs.get_type()->as<mty::Integer>() )
+				 if ( auto itype = scalar_type( lhs.get_type() )->as<mty::Integer>() )
 				 {
-					 return QualifiedValue( type, Builder.CreateICmpEQ( lhs.get(), rhs.get() ) );
+					 return compare_result( lhs.get_type(), Builder.CreateICmpEQ( lhs.get(), rhs.get() ) );
 				 }
 				 else
 				 {
-					 return QualifiedValue( type, Builder.CreateFCmpOEQ( lhs.get(), rhs.get() ) );
+					 return compare_result( lhs.get_type(), Builder.CreateFCmpOEQ( lhs.get(), rhs.get() ) );
 				 }
 			 }
 			 else
@@ -374,13 +435,13 @@ static QualifiedValue handle_binary_expr( const char *op, QualifiedValue &lhs, Q
 			 if ( !QualifiedValue::cast_binary_ptr( lhs, rhs, ast, true ) )
 			 {
 				 QualifiedValue::cast_binary_expr( lhs, rhs, ast );
-				 if ( auto itype = lhs.get_type()->as<mty::Integer>() )
+				 if ( auto itype = scalar_type( lhs.get_type() )->as<mty::Integer>() )
 				 {
-					 return QualifiedValue( type, Builder.CreateICmpNE( lhs.get(), rhs.get() ) );
+					 return compare_result( lhs.get_type(), Builder.CreateICmpNE( lhs.get(), rhs.get() ) );
 				 }
 				 else
 				 {
-					 return QualifiedValue( type, Builder.CreateFCmpONE( lhs.get(), rhs.get() ) );
+					 return compare_result( lhs.get_type(), Builder.CreateFCmpONE( lhs.get(), rhs.get() ) );
 				 }
 			 }
 			 else
@@ -466,6 +527,14 @@ int Expression::reg()
 								 ast );
 							   HALT();
 						   }
+						   if ( val.is_vector_element() )
+						   {
+							   infoList->add_msg(
+								 MSG_TYPE_ERROR,
+								 fmt( "address of vector element requested" ),
+								 ast );
+							   HALT();
+						   }
 						   auto builder = DeclarationSpecifiers()
 											.add_type( val.get_type().into_type(), ast )
 											.into_type_builder( ast );
@@ -544,6 +613,10 @@ int Expression::reg()
 			  static JumpTable<QualifiedValue( Json::Value & children, QualifiedValue & val, Json::Value & )> __ = {
 				  { "[", []( Json::Value &children, QualifiedValue &val, Json::Value &node ) -> QualifiedValue {
 					   auto off = get<QualifiedValue>( codegen( children[ 2 ] ) );
+					   if ( val.get_type()->is<mty::Vector>() )
+					   {
+						   return val.get_element( off, node );
+					   }
 					   return val.value( children[ 0 ] )
 						 .offset( off.value( children[ 2 ] ).get(), node )
 						 .deref( node );
@@ -638,6 +711,74 @@ int Expression::reg()
 				  INTERNAL_ERROR();
 			  }
 		  } ) },
+		{ "shuffle_vector_expression", pack_fn<VoidType, QualifiedValue>( []( Json::Value &node, VoidType const & ) -> QualifiedValue {
+			  auto &children = node[ "children" ];
+			  std::vector<int> args;
+			  for ( int i = 2; i < children.size() - 1; ++i )
+			  {
+				  if ( children[ i ].isObject() ) args.push_back( i );
+			  }
+			  if ( args.size() < 3 )
+			  {
+				  infoList->add_msg(
+					MSG_TYPE_ERROR,
+					fmt( "too few arguments to `__builtin_shufflevector`, expected at least 3, have ", args.size() ),
+					node );
+				  HALT();
+			  }
+
+			  auto &lhs_ast = children[ args[ 0 ] ];
+			  auto &rhs_ast = children[ args[ 1 ] ];
+			  auto lhs = get<QualifiedValue>( codegen( lhs_ast ) ).value( lhs_ast );
+			  auto rhs = get<QualifiedValue>( codegen( rhs_ast ) ).value( rhs_ast );
+			  auto vec = lhs.get_type()->as<mty::Vector>();
+			  if ( !vec || !lhs.get_type().is_same_discard_qualifiers( rhs.get_type() ) )
+			  {
+				  infoList->add_msg(
+					MSG_TYPE_ERROR,
+					fmt( "`__builtin_shufflevector` requires two vectors of the same type (`",
+						 lhs.get_type(), "` and `", rhs.get_type(), "`)" ),
+					node );
+				  HALT();
+			  }
+
+			  // -1 selects an undefined element
+			  std::vector<Constant *> mask;
+			  for ( auto i = 2; i != args.size(); ++i )
+			  {
+				  auto &ast = children[ args[ i ] ];
+				  auto idx = dyn_cast<ConstantInt>(
+					get<QualifiedValue>( codegen( ast ) ).value( ast ).get() );
+				  if ( !idx || idx->getSExtValue() < -1 || idx->getSExtValue() >= int64_t( 2 * vec->len ) )
+				  {
+					  infoList->add_msg(
+						MSG_TYPE_ERROR,
+						fmt( "index for `__builtin_shufflevector` must be a constant integer in [-1, ", 2 * vec->len, ")" ),
+						ast );
+					  HALT();
+				  }
+				  mask.push_back( idx->isMinusOne() ? static_cast<Constant *>( UndefValue::get( Builder.getInt32Ty() ) )
+													: Builder.getInt32( idx->getZExtValue() ) );
+			  }
+
+			  auto elem_ty = lhs.get_type();
+			  elem_ty.next();
+			  auto builder = DeclarationSpecifiers()
+							   .add_type( elem_ty.into_type(), node )
+							   .into_type_builder( node );
+			  auto type = builder
+							.add_level( std::make_shared<mty::Vector>( elem_ty->type, mask.size() ) )
+							.build();
+			  return QualifiedValue(
+				TypeView( std::make_shared<QualifiedType>( type ) ),
+				Builder.CreateShuffleVector( lhs.get(), rhs.get(), ConstantVector::get( mask ) ) );
+		  } ) },
+		{ "convert_vector_expression", pack_fn<VoidType, QualifiedValue>( []( Json::Value &node, VoidType const & ) -> QualifiedValue {
+			  auto &children = node[ "children" ];
+			  auto type = std::make_shared<QualifiedType>( get<QualifiedType>( codegen( children[ 4 ] ) ) );
+			  auto val = get<QualifiedValue>( codegen( children[ 2 ] ) ).value( children[ 2 ] );
+			  return val.convert_vector( TypeView( type ), node );
+		  } ) },
 		{ "primary_expression", pack_fn<VoidType, QualifiedValue>( []( Json::Value &node, VoidType const & ) -> QualifiedValue {
 			  auto &children = node[ "children" ];
 			  if ( children.size() > 1 )
@@ -656,7 +797,8 @@ int Expression::reg()
 						   {
 							   if ( sym->is_value() )
 							   {
-								   return sym->as_value();
+								   auto value = sym->as_value();
+								   return value.materialize( val );
 							   }
 							   else
 							   {
@@ -691,26 +833,24 @@ int Expression::reg()
 														  type->type, APInt( type->as<mty::Integer>()->bits, num, is_signed ) ) );
 					   } },
 					  { "FLOATING_POINT", []( Json::Value &node ) -> QualifiedValue {
-						   auto val = node[1].asCString();
-						   auto num = std::strtold( val, nullptr );
+						   StringRef val = node[1].asCString();
 						   int is_double = 0;
 
-						   while ( *val != 0 )
+						   switch ( val.back() )
 						   {
-							   switch ( *val++ )
-							   {
-							   case 'f':
-							   case 'F': is_double = -1; break;
-							   case 'l':
-							   case 'L':
-								   is_double = 1;
-								   infoList->add_msg( MSG_TYPE_WARNING, "`long double` literal is not currently supported", node );
-								   break;
-							   }
+						   case 'f':
+						   case 'F': is_double = -1; break;
+						   case 'l':
+						   case 'L': is_double = 1; break;
 						   }
+						   if ( is_double ) val = val.drop_back();
 						   auto &type = is_double == 0 ? TypeView::getDoubleTy() : is_double == 1 ? TypeView::getLongDoubleTy() : TypeView::getFloatTy();
 
-						   return QualifiedValue( type, ConstantFP::get( type->type, num ) );
+						   // round the text straight to the target format, a host long double may be narrower
+						   APFloat num( type->type->getFltSemantics() );
+						   num.convertFromString( val, APFloat::rmNearestTiesToEven );
+
+						   return QualifiedValue( type, ConstantFP::get( TheContext, num ) );
 					   } },
 					  { "CHAR", []( Json::Value &node ) -> QualifiedValue {
 						   auto val = node[1].asCString();
@@ -1,4 +1,5 @@
 #include "initializer.h"
+#include "../debuginfo.h"
 
 static void traverse( const InitItem &item, const std::function<void( const InitItem & )> &handle )
 {
@@ -18,6 +19,77 @@ static Constant *make_constant_struct( const mty::Struct *struct_ty, InitList &i
 static Constant *make_constant_union( const mty::Union *union_ty, InitList &init,
 									  std::size_t &curr );
 
+static Constant *make_constant_vector( TypeView vec_ty, InitList &init,
+									   std::size_t &curr );
+
+// a vector initialized by a whole vector value rather than by its elements
+static bool is_vector_value( const InitItem &item )
+{
+	return item.value.is_some() && item.value.unwrap().get_type()->is<mty::Vector>();
+}
+
+// a constant of `type` from elements some of which have a literal type
+// ( see make_constant_union ): a packed literal struct that keeps every
+// element at its offset in `type`
+static Constant *make_literal_struct( StructType *type, const std::vector<Constant *> &elems )
+{
+	auto layout = TheDataLayout->getStructLayout( type );
+	std::vector<Constant *> fields;
+	uint64_t offset = 0;
+
+	auto pad_to = [&]( uint64_t next ) {
+		if ( next > offset )
+		{
+			fields.emplace_back( Constant::getNullValue(
+			  ArrayType::get( Type::getInt8Ty( TheContext ), next - offset ) ) );
+		}
+		offset = next;
+	};
+
+	for ( unsigned i = 0; i < elems.size(); ++i )
+	{
+		pad_to( layout->getElementOffset( i ) );
+		fields.emplace_back( elems[ i ] );
+		offset += TheDataLayout->getTypeAllocSize( elems[ i ]->getType() );
+	}
+	pad_to( layout->getSizeInBytes() );
+
+	return ConstantStruct::getAnon( fields, true );
+}
+
+static bool has_literal_elem( Type *elem_ty, const std::vector<Constant *> &elems )
+{
+	for ( auto elem : elems )
+	{
+		if ( elem->getType() != elem_ty ) return true;
+	}
+	return false;
+}
+
+// gives `var` the initializer `cc`. A literal initializer needs a global of
+// its own type, which replaces `var`: uses see it through a bitcast
+static Value *set_initializer( GlobalVariable *var, Constant *cc )
+{
+	if ( cc->getType() == var->getValueType() )
+	{
+		var->setInitializer( cc );
+		return var;
+	}
+
+	auto glob = new GlobalVariable( *TheModule, cc->getType(), var->isConstant(), var->getLinkage(),
+									cc, "", var, var->getThreadLocalMode() );
+	glob->copyAttributesFrom( var );
+	if ( !glob->getAlignment() )
+	{
+		glob->setAlignment( TheDataLayout->getPreferredAlignment( var ) );
+	}
+	glob->takeName( var );
+	auto cast = ConstantExpr::getBitCast( glob, var->getType() );
+	var->replaceAllUsesWith( cast );
+	var->eraseFromParent();
+	return cast;
+}
+
 Constant *make_constant_value( const TypeView &view, QualifiedValue &value, Json::Value &ast )
 {
 	if ( dyn_cast_or_null<Constant>( value.get() ) )
@@ -78,6 +150,28 @@ static Constant *make_constant_object( TypeView elem, InitList &init,
 			return make_constant_struct( struct_ty, init, curr );
 		}
 	}
+	else if ( elem->is<mty::Vector>() && !is_vector_value( init[ curr ] ) )
+	{
+		if ( init[ curr ].value.is_none() )
+		{  // v4si a[] = { {0, 1, 2, 3} ... };
+			auto &desc = init[ curr ].childs;
+			std::size_t curr_ch = 0;
+			auto cc = make_constant_vector( elem, desc, curr_ch );
+			if ( desc.size() > curr_ch )
+			{
+				infoList->add_msg(
+				  MSG_TYPE_WARNING,
+				  fmt( "excess elements in vector initializer" ),
+				  desc[ curr_ch ].ast );
+			}
+			++curr;
+			return cc;
+		}
+		else
+		{  // v4si a[] = { 0, 1, 2, 3 ... };
+			return make_constant_vector( elem, init, curr );
+		}
+	}
 	else if ( auto union_ty = elem->as<mty::Union>() )
 	{
 		if ( init[ curr ].value.is_none() )
@@ -185,12 +279,14 @@ static Constant *make_constant_array( TypeView array_ty, InitList &init, std::si
 		}
 	}
 
-	auto arr_val = ConstantArray::get(
-	  is_fixed_size ? static_cast<ArrayType *>( arr->type )
-					: ArrayType::get( arr->type, *array_len ),
-	  elems );
+	auto type = is_fixed_size ? static_cast<ArrayType *>( arr->type )
+							  : ArrayType::get( arr->type, *array_len );
+	if ( has_literal_elem( type->getElementType(), elems ) )
+	{  // elements keep the stride of the array, they have its element size
+		return ConstantStruct::getAnon( elems, true );
+	}
 
-	return arr_val;
+	return ConstantArray::get( type, elems );
 }
 
 static Constant *make_constant_struct( const mty::Struct *struct_ty, InitList &init,
@@ -213,8 +309,16 @@ static Constant *make_constant_struct( const mty::Struct *struct_ty, InitList &i
 		}
 	}
 
-	return ConstantStruct::get(
-	  static_cast<StructType *>( struct_ty->type ), elems );
+	auto type = static_cast<StructType *>( struct_ty->type );
+	for ( unsigned i = 0; i < elems.size(); ++i )
+	{
+		if ( elems[ i ]->getType() != type->getElementType( i ) )
+		{
+			return make_literal_struct( type, elems );
+		}
+	}
+
+	return ConstantStruct::get( type, elems );
 }
 
 static Constant *make_constant_union( const mty::Union *union_ty, InitList &init,
@@ -237,8 +341,50 @@ static Constant *make_constant_union( const mty::Union *union_ty, InitList &init
 		}
 	}
 
-	return ConstantStruct::get(
-	  static_cast<StructType *>( union_ty->type ), elems );
+	auto body = static_cast<StructType *>( union_ty->type );
+	if ( elems.size() && elems[ 0 ]->getType() != body->getElementType( 0 ) )
+	{  // the body starts with the most aligned member, not the first one:
+	   // { first member, i8 padding } with the size of the union
+		auto size = TheDataLayout->getTypeAllocSize( body ) -
+					TheDataLayout->getTypeAllocSize( elems[ 0 ]->getType() );
+		if ( size )
+		{
+			elems.emplace_back( Constant::getNullValue(
+			  ArrayType::get( Type::getInt8Ty( TheContext ), size ) ) );
+		}
+		return ConstantStruct::getAnon( elems );
+	}
+
+	// padding up to the size and alignment of the union
+	for ( auto i = elems.size(); i < body->getNumElements(); ++i )
+	{
+		elems.emplace_back( Constant::getNullValue( body->getElementType( i ) ) );
+	}
+
+	return ConstantStruct::get( body, elems );
+}
+
+static Constant *make_constant_vector( TypeView vec_ty, InitList &init,
+									   std::size_t &curr )
+{
+	std::vector<Constant *> elems;
+
+	auto vec = vec_ty->as<mty::Vector>();
+	auto &elem_ty = vec_ty.next();
+
+	for ( std::size_t i = 0; i < vec->len; ++i )
+	{
+		if ( curr < init.size() )
+		{
+			elems.emplace_back( make_constant_object( elem_ty, init, curr ) );
+		}
+		else
+		{
+			elems.emplace_back( Constant::getNullValue( elem_ty->type ) );
+		}
+	}
+
+	return ConstantVector::get( elems );
 }
 
 static Constant *make_constant_init( const QualifiedType &type, InitItem &init, uint64_t &array_len )
@@ -320,6 +466,9 @@ static void make_local_struct( QualifiedValue &agg, InitList &init,
 static void make_local_union( QualifiedValue &agg, InitList &init,
 							  std::size_t &curr );
 
+static void make_local_vector( QualifiedValue &vec, InitList &init,
+							   std::size_t &curr );
+
 void make_local_value( QualifiedValue alloc, QualifiedValue value, Json::Value &ast )
 {
 	if ( !dyn_cast_or_null<Constant>( value.get() ) )
@@ -393,6 +542,27 @@ static void make_local_object( QualifiedValue elem, InitList &init,
 			make_local_struct( elem, init, curr );
 		}
 	}
+	else if ( elem.get_type()->is<mty::Vector>() && !is_vector_value( init[ curr ] ) )
+	{
+		if ( init[ curr ].value.is_none() )
+		{  // v4si a[] = { {0, 1, 2, 3} ... };
+			auto &desc = init[ curr ].childs;
+			std::size_t curr_ch = 0;
+			make_local_vector( elem, desc, curr_ch );
+			if ( desc.size() > curr_ch )
+			{
+				infoList->add_msg(
+				  MSG_TYPE_WARNING,
+				  fmt( "excess elements in vector initializer" ),
+				  desc[ curr_ch ].ast );
+			}
+			++curr;
+		}
+		else
+		{
+			make_local_vector( elem, init, curr );
+		}
+	}
 	else if ( auto union_ty = elem.get_type()->as<mty::Union>() )
 	{
 		if ( init[ curr ].value.is_none() )
@@ -520,6 +690,28 @@ static void make_local_union( QualifiedValue &agg, InitList &init,
 	}
 }
 
+static void make_local_vector( QualifiedValue &vec, InitList &init,
+							   std::size_t &curr )
+{
+	auto len = vec.get_type()->as<mty::Vector>()->len;
+	auto &index_ty = TypeView::getLongLongTy( false );
+
+	Json::Value ast;
+
+	for ( uint64_t i = 0; i < len; ++i )
+	{
+		auto elem = vec;
+		auto index = QualifiedValue(
+		  index_ty,
+		  ConstantInt::get( index_ty->type, APInt( 64, i, false ) ) );
+		elem.get_element( index, ast );
+		if ( curr < init.size() )
+		{
+			make_local_object( elem, init, curr );
+		}
+	}
+}
+
 static void make_local_init( QualifiedValue val, InitItem &init )
 {
 	if ( init.value.is_none() )
@@ -616,6 +808,8 @@ int Initializer::reg()
 						  auto decl = get<QualifiedDecl>( codegen( children[ 0 ], &builder ) );
 						  auto &type = decl.type;
 						  auto &name = decl.name.unwrap();
+						  auto attrs = declspec.get_gnu_attributes();
+						  attrs.merge( decl.attrs, children[ 0 ] );
 
 						  auto make_type_len = [&]( uint64_t len ) {
 							  auto builder = DeclarationSpecifiers()
@@ -674,24 +868,28 @@ int Initializer::reg()
 								  auto ty = std::make_shared<QualifiedType>( type );
 								  if ( auto fn = globObjects.find( name ) )  // this function has forward declaration
 								  {
+									  if ( auto fn_obj = dyn_cast_or_null<Function>( fn->value.get() ) )
+									  {
+										  attrs.apply( fn_obj );
+									  }
+									  else  // not emitted yet
+									  {
+										  attrs.merge( fn->attrs, children[ 0 ] );
+									  }
 									  auto fn_val = QualifiedValue( ty, fn->value.get() );
 									  globObjects.insert_if(
 										name,
-										Global( fn_val, declspec.has_attribute( SC_STATIC ) ),
+										Global( fn_val, declspec.has_attribute( SC_STATIC ), false, attrs ),
 										children[ 0 ],
 										declare_global );
 									  symTable.insert( name, fn_val, children[ 0 ] );
 								  }
-								  else  // declare this function now and insert into global
+								  else  // record the prototype, the function is emitted on first use
 								  {
-									  auto fn_val = QualifiedValue(
-										ty,
-										Function::Create(
-										  static_cast<FunctionType *>( type.get()->type ),
-										  GlobalValue::ExternalLinkage, name, TheModule.get() ) );
+									  auto fn_val = QualifiedValue( ty, nullptr );
 									  globObjects.insert_if(
 										name,
-										Global( fn_val, declspec.has_attribute( SC_STATIC ) ),
+										Global( fn_val, declspec.has_attribute( SC_STATIC ), false, attrs ),
 										children[ 0 ],
 										declare_global );
 									  symTable.insert( name, fn_val, children[ 0 ] );
@@ -725,6 +923,14 @@ int Initializer::reg()
 									  }
 								  }
 
+								  if ( attrs.has_attribute( FUNCTION_ATTRIBUTE ) )
+								  {
+									  infoList->add_msg(
+										MSG_TYPE_WARNING,
+										fmt( "function attributes ignored on variable `", name, "`" ),
+										children[ 0 ] );
+								  }
+
 								  // deal with decl
 								  Value *alloc = nullptr;
 								  if ( declspec.has_attribute( SC_EXTERN ) ||
@@ -759,11 +965,21 @@ int Initializer::reg()
 
 									  Option<QualifiedValue> glob_val;
 									  auto ty = TypeView( std::make_shared<QualifiedType>( type ) );
+									  // an extern declaration is only emitted once the variable is used
+									  auto is_lazy = declspec.has_attribute( SC_EXTERN ) && init.is_none();
 
 									  if ( auto glob = globObjects.find( name ) )  // this variable is already declared
 									  {
 										  alloc = glob->value.get();
-										  auto glob_alloc = static_cast<GlobalVariable *>( alloc );
+										  if ( !alloc )
+										  {
+											  attrs.merge( glob->attrs, children[ 0 ] );
+											  if ( !is_lazy ) alloc = materialize_global( name, glob->value.get_type() );
+										  }
+										  if ( auto glob_alloc = dyn_cast_or_null<GlobalVariable>( alloc ? alloc->stripPointerCasts() : nullptr ) )
+										  {
+											  attrs.apply( glob_alloc );
+										  }
 										  glob_val = QualifiedValue( ty, alloc, !type.is<mty::Address>() );
 										  auto is_allocated = glob->is_allocated;
 
@@ -771,8 +987,14 @@ int Initializer::reg()
 										  {
 											  if ( cc )
 											  {
-												  glob_alloc->setInitializer( cc );
+												  alloc = set_initializer( static_cast<GlobalVariable *>( alloc ), cc );
+												  glob_val = QualifiedValue( ty, alloc, !type.is<mty::Address>() );
 												  is_allocated = true;
+												  if ( TheDebugInfo )
+												  {
+													  TheDebugInfo->declare_global(
+														cast<GlobalVariable>( alloc->stripPointerCasts() ), name, ty, children[ 0 ] );
+												  }
 											  }
 										  }
 
@@ -780,7 +1002,7 @@ int Initializer::reg()
 										  {
 											  globObjects.insert_if(
 												name,
-												Global( glob_val.unwrap(), false, init.is_some() ),
+												Global( glob_val.unwrap(), false, init.is_some(), attrs ),
 												children[ 0 ],
 												declare_global );
 										  }
@@ -788,13 +1010,22 @@ int Initializer::reg()
 										  {
 											  globObjects.insert_if(
 												name,
-												Global( glob_val.unwrap(), true, init.is_some() ),
+												Global( glob_val.unwrap(), true, init.is_some(), attrs ),
 												children[ 0 ],
 												[]( const std::string &,
 													const Global &, const Global &,
 													Json::Value & ) { return true; } );
 										  }
 									  }
+									  else if ( is_lazy )
+									  {
+										  glob_val = QualifiedValue( ty, nullptr, !type.is<mty::Address>() );
+										  globObjects.insert_if(
+											name,
+											Global( glob_val.unwrap(), false, false, attrs ),
+											children[ 0 ],
+											declare_global );
+									  }
 									  else  // this variable is not declared yet
 									  {
 										  auto linkage = GlobalVariable::ExternalWeakLinkage;  //CommonLinkage;
@@ -815,7 +1046,18 @@ int Initializer::reg()
 											  if ( !cc ) cc = ConstantAggregateZero::get( type->type );
 										  }
 
-										  alloc = new GlobalVariable( *TheModule, type->type, false, linkage, cc );
+										  auto glob_alloc = new GlobalVariable( *TheModule, type->type, false, linkage, nullptr );
+										  attrs.apply( glob_alloc );
+										  alloc = glob_alloc;
+										  if ( cc )
+										  {
+											  alloc = set_initializer( glob_alloc, cc );
+											  if ( TheDebugInfo )
+											  {
+												  TheDebugInfo->declare_global(
+													cast<GlobalVariable>( alloc->stripPointerCasts() ), name, ty, children[ 0 ] );
+											  }
+										  }
 										  glob_val = QualifiedValue( ty, alloc, !type.is<mty::Address>() );
 										  //   TODO( "maybe not correct" );
 										  globObjects.insert_if(
@@ -849,12 +1091,16 @@ int Initializer::reg()
 											  make_type_len( len );
 										  }
 									  }
-									  alloc = Builder.CreateAlloca( type->type );
+									  auto stack_alloc = Builder.CreateAlloca( type->type );
+									  attrs.apply( stack_alloc );
+									  alloc = stack_alloc;
 									  if ( cc )
 									  {
-										  auto glob = new GlobalVariable( *TheModule, type->type, false, GlobalValue::InternalLinkage, cc );
+										  auto glob = new GlobalVariable( *TheModule, cc->getType(), false, GlobalValue::InternalLinkage, cc );
 										  auto size = TheDataLayout->getTypeAllocSize( type->type );
-										  Builder.CreateMemCpy( alloc, 1, glob, 1, size );
+										  auto align = TheDataLayout->getABITypeAlignment( type->type );
+										  if ( cc->getType() != type->type ) glob->setAlignment( align );
+										  Builder.CreateMemCpy( alloc, align, glob, align, size );
 										  auto ival = QualifiedValue(
 											std::make_shared<QualifiedType>( type ), alloc, !type.is<mty::Address>() );
 										  make_local_init( ival, init.unwrap() );
@@ -864,8 +1110,13 @@ int Initializer::reg()
 										QualifiedValue(
 										  std::make_shared<QualifiedType>( type ), alloc, !type.is<mty::Address>() ),
 										children[ 0 ] );
+									  if ( TheDebugInfo )
+									  {
+										  TheDebugInfo->declare_variable(
+											alloc, name, TypeView( std::make_shared<QualifiedType>( type ) ), children[ 0 ] );
+									  }
 								  }
-								  alloc->setName( name );
+								  if ( alloc ) alloc->setName( name );
 							  }
 						  }
 					  }
@@ -0,0 +1,408 @@
+#include "omp.h"
+#include "../debuginfo.h"
+#include "../workshare.h"
+
+static const char *const construct = "`#pragma omp parallel for`";
+
+static bool is_identifier( Json::Value &node, std::string &name )
+{
+	if ( !node.isObject() || node[ "type" ].asString() != "primary_expression" ) return false;
+	auto &children = node[ "children" ];
+	if ( children.size() != 1 || !children[ 0 ].isArray() || children[ 0 ][ 0 ].asString() != "IDENTIFIER" ) return false;
+	name = children[ 0 ][ 1 ].asString();
+	return true;
+}
+
+// for ( var = start; var < bound; var += step ), and its variations
+struct CanonicalLoop
+{
+	std::string var;
+	Json::Value *var_node, *start, *bound, *step;  // step is null for ++ and --
+	bool up, inclusive, negate;					   // negate: the step is subtracted
+};
+
+static bool match_canonical_loop( Json::Value &children, CanonicalLoop &loop )
+{
+	std::string name;
+
+	auto &init = children[ 2 ][ "children" ];
+	if ( init.size() != 2 ) return false;
+	auto &assign = init[ 0 ];
+	if ( assign[ "type" ].asString() != "assignment_expression" ||
+		 assign[ "children" ][ 1 ][ 1 ].asString() != "=" ||
+		 !is_identifier( assign[ "children" ][ 0 ], loop.var ) )
+	{
+		return false;
+	}
+	loop.var_node = &assign[ "children" ][ 0 ];
+	loop.start = &assign[ "children" ][ 2 ];
+
+	auto &test = children[ 3 ][ "children" ];
+	if ( test.size() != 2 || test[ 0 ][ "type" ].asString() != "relational_expression_" ) return false;
+	auto op = test[ 0 ][ "children" ][ 1 ][ 1 ].asString();
+	if ( !is_identifier( test[ 0 ][ "children" ][ 0 ], name ) || name != loop.var ) return false;
+	loop.up = op[ 0 ] == '<';
+	loop.inclusive = op.size() == 2;
+	loop.bound = &test[ 0 ][ "children" ][ 2 ];
+
+	auto &inc = children[ 4 ];
+	if ( !inc.isObject() ) return false;
+	auto type = inc[ "type" ].asString();
+	auto &parts = inc[ "children" ];
+	loop.step = nullptr;
+	if ( type == "postfix_expression" && parts.size() == 2 && is_identifier( parts[ 0 ], name ) )
+	{
+		op = parts[ 1 ][ 1 ].asString();
+	}
+	else if ( type == "unary_expression" && parts.size() == 2 && is_identifier( parts[ 1 ], name ) )
+	{
+		op = parts[ 0 ][ 1 ].asString();
+	}
+	else if ( type == "assignment_expression" && is_identifier( parts[ 0 ], name ) )
+	{
+		op = parts[ 1 ][ 1 ].asString();
+		loop.step = &parts[ 2 ];
+		if ( op == "+=" ) op = "++";
+		else if ( op == "-=" ) op = "--";
+	}
+	else
+	{
+		return false;
+	}
+	loop.negate = op == "--";
+	return name == loop.var && ( op == "++" || op == "--" );
+}
+
+// the body runs in a function of its own, nothing may jump out of it
+static bool check_body( Json::Value &node, int breakable, int switches )
+{
+	if ( !node.isObject() ) return true;
+	auto type = node[ "type" ].asString();
+	Json::Value none;
+	auto &children = node[ "children" ];
+	auto &first = children.size() ? children[ 0 ] : none;
+	auto word = first.isArray() ? first[ 1 ].asString() : "";
+	bool ok = true;
+
+	if ( type == "jump_statement" && ( word == "return" || word == "goto" || ( word == "break" && !breakable ) ) )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, fmt( "`", word, "` cannot leave the body of ", construct ), node );
+		ok = false;
+	}
+	else if ( type == "labeled_statement" && first.isArray() && first[ 0 ].asString() == "IDENTIFIER" )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, fmt( "label `", word, "` in the body of ", construct ), node );
+		ok = false;
+	}
+	else if ( type == "labeled_statement" && !switches )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, fmt( "`", word, "` label of an enclosing switch in the body of ", construct ), node );
+		ok = false;
+	}
+	else if ( type == "iteration_statement" )
+	{
+		++breakable;
+	}
+	else if ( type == "selection_statement" && word == "switch" )
+	{
+		++breakable;
+		++switches;
+	}
+
+	for ( int i = 0; i < children.size(); ++i )
+	{
+		ok = check_body( children[ i ], breakable, switches ) && ok;
+	}
+	return ok;
+}
+
+// a variable of the enclosing function, seen from the outlined body
+static QualifiedValue shared_variable( const std::string &name, Json::Value &pragma )
+{
+	auto sym = symTable.find( name );
+	if ( !sym || !sym->is_value() )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, fmt( "use of undeclared identifier `", name, "` in ", construct ), pragma );
+		HALT();
+	}
+	auto value = sym->as_value();
+	value.materialize( name );
+	if ( value.is_rvalue() || value.get_type()->is<mty::Function>() )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, fmt( "`", name, "` in ", construct, " is not a variable" ), pragma );
+		HALT();
+	}
+	return value;
+}
+
+static AllocaInst *declare_private( const std::string &name, const TypeView &type, Json::Value &node )
+{
+	auto alloc = Builder.CreateAlloca( type->type, nullptr, name );
+	symTable.insert( name, QualifiedValue( type, alloc, !type->is<mty::Address>() ), node );
+	if ( TheDebugInfo ) TheDebugInfo->declare_variable( alloc, name, type, node );
+	return alloc;
+}
+
+struct Reduction
+{
+	std::string op;
+	QualifiedValue shared;
+	AllocaInst *partial;
+};
+
+static Constant *reduction_identity( const std::string &op, const TypeView &type, Json::Value &pragma )
+{
+	auto ty = type->type;
+	if ( type->is<mty::Integer>() )
+	{
+		if ( op == "*" ) return ConstantInt::get( ty, 1 );
+		if ( op == "&" ) return ConstantInt::getAllOnesValue( ty );
+		return ConstantInt::get( ty, 0 );
+	}
+	if ( type->is<mty::FloatingPoint>() && ( op == "+" || op == "-" || op == "*" ) )
+	{
+		return ConstantFP::get( ty, op == "*" ? 1.0 : 0.0 );
+	}
+	infoList->add_msg( MSG_TYPE_ERROR, fmt( "invalid reduction `", op, "` of type `", type, "` in ", construct ), pragma );
+	HALT();
+}
+
+static Value *combine( const std::string &op, Value *lhs, Value *rhs )
+{
+	bool fp = lhs->getType()->isFloatingPointTy();
+	if ( op == "*" ) return fp ? Builder.CreateFMul( lhs, rhs ) : Builder.CreateMul( lhs, rhs );
+	if ( op == "&" ) return Builder.CreateAnd( lhs, rhs );
+	if ( op == "|" ) return Builder.CreateOr( lhs, rhs );
+	if ( op == "^" ) return Builder.CreateXor( lhs, rhs );
+	// the partial results of `-` are sums as well
+	return fp ? Builder.CreateFAdd( lhs, rhs ) : Builder.CreateAdd( lhs, rhs );
+}
+
+// everything of another function the outlined one refers to is passed in a
+// frame behind its first argument, the caller fills it at the call
+static StructType *capture_frame( Function *fn, std::vector<Value *> &captures )
+{
+	std::map<Value *, unsigned> index;
+	for ( auto &bb : *fn )
+	{
+		for ( auto &inst : bb )
+		{
+			for ( auto &op : inst.operands() )
+			{
+				auto val = op.get();
+				auto def = dyn_cast<Instruction>( val );
+				auto arg = dyn_cast<Argument>( val );
+				if ( ( def && def->getFunction() != fn ) || ( arg && arg->getParent() != fn ) )
+				{
+					if ( index.emplace( val, captures.size() ).second ) captures.push_back( val );
+				}
+			}
+		}
+	}
+
+	std::vector<Type *> types;
+	for ( auto val : captures ) types.push_back( val->getType() );
+	auto frame_ty = StructType::get( TheContext, types );
+
+	auto &entry = fn->getEntryBlock();
+	IRBuilder<> builder( &entry, entry.begin() );
+	auto frame = builder.CreateBitCast( &*fn->arg_begin(), frame_ty->getPointerTo() );
+	std::vector<Value *> loaded;
+	for ( unsigned i = 0; i != captures.size(); ++i )
+	{
+		loaded.push_back( builder.CreateLoad( builder.CreateStructGEP( frame_ty, frame, i ), captures[ i ]->getName() ) );
+	}
+
+	for ( auto &bb : *fn )
+	{
+		for ( auto &inst : bb )
+		{
+			for ( auto &op : inst.operands() )
+			{
+				auto it = index.find( op.get() );
+				if ( it != index.end() ) op.set( loaded[ it->second ] );
+			}
+		}
+	}
+	return frame_ty;
+}
+
+void lower_parallel_for( const LoopHints &hints, Json::Value &children, Json::Value &ast )
+{
+	auto omp = hints.omp.unwrap();
+	auto &pragma = omp.pragma;
+	int index = children[ 4 ].isObject() ? 6 : 5;
+
+	CanonicalLoop loop;
+	if ( !match_canonical_loop( children, loop ) )
+	{
+		infoList->add_msg(
+		  MSG_TYPE_ERROR,
+		  fmt( construct, " needs a loop of the form `for ( i = lb; i < ub; i += step )`" ),
+		  ast );
+		HALT();
+	}
+	if ( !check_body( children[ index ], 0, 0 ) ) HALT();
+
+	auto var = get<QualifiedValue>( codegen( *loop.var_node ) );
+	auto type = var.get_type();
+	auto itype = type->as<mty::Integer>();
+	if ( !itype || var.is_rvalue() )
+	{
+		infoList->add_msg( MSG_TYPE_ERROR, fmt( "the loop variable of ", construct, " must be an integer" ), *loop.var_node );
+		HALT();
+	}
+
+	// the iterations are counted in 64 bits, as the loop would run them
+	auto i64 = Builder.getInt64Ty();
+	auto zero = Builder.getInt64( 0 );
+	auto one = Builder.getInt64( 1 );
+	auto widen = [&]( Json::Value &node ) -> Value * {
+		auto val = get<QualifiedValue>( codegen( node ) ).value( node ).cast( type, node ).get();
+		return itype->is_signed ? Builder.CreateSExt( val, i64 ) : Builder.CreateZExt( val, i64 );
+	};
+	auto start = widen( *loop.start );
+	auto bound = widen( *loop.bound );
+	Value *step = loop.step ? widen( *loop.step ) : one;
+	if ( loop.negate ) step = Builder.CreateNeg( step );
+
+	auto dist = loop.up ? Builder.CreateSub( bound, start ) : Builder.CreateSub( start, bound );
+	if ( loop.inclusive ) dist = Builder.CreateAdd( dist, one );
+	auto stride = loop.up ? step : Builder.CreateNeg( step );
+	auto runs = Builder.CreateAnd( Builder.CreateICmpSGT( dist, zero ), Builder.CreateICmpSGT( stride, zero ) );
+	stride = Builder.CreateSelect( runs, stride, one );
+	auto trip = Builder.CreateSelect(
+	  runs, Builder.CreateSDiv( Builder.CreateAdd( dist, Builder.CreateSub( stride, one ) ), stride ), zero );
+
+	// the body is generated right into the outlined function
+	auto outer = static_cast<Function *>( currentFunction->get() );
+	auto i8p = Builder.getInt8PtrTy();
+	auto fn = Function::Create( FunctionType::get( Builder.getVoidTy(), { i8p, i8p }, false ),
+								GlobalValue::InternalLinkage, outer->getName() + ".omp_outlined", TheModule.get() );
+	// only what codegen of the body depends on, not e.g. noinline or the
+	// memory attributes of `outer`
+	for ( auto kind : { "target-cpu", "target-features", "unsafe-fp-math", "no-infs-fp-math",
+						"no-nans-fp-math", "no-signed-zeros-fp-math", "frame-pointer", "no-frame-pointer-elim" } )
+	{
+		if ( outer->hasFnAttribute( kind ) )
+		{
+			fn->addFnAttr( outer->getFnAttribute( kind ) );
+		}
+	}
+	fn->addFnAttr( Attribute::NoUnwind );
+	auto thread = fn->arg_begin() + 1;
+
+	auto saved_ip = Builder.saveIP();
+	auto saved_loc = Builder.getCurrentDebugLocation();
+	auto saved_fn = currentFunction;
+	currentFunction = std::make_shared<QualifiedValue>( saved_fn->get_type(), fn, false );
+
+	auto entry = BasicBlock::Create( TheContext, "entry", fn );
+	auto next = BasicBlock::Create( TheContext, "omp.next", fn );
+	auto range = BasicBlock::Create( TheContext, "omp.range", fn );
+	auto cond = BasicBlock::Create( TheContext, "omp.cond", fn );
+	auto body = BasicBlock::Create( TheContext, "omp.body", fn );
+	auto inc = BasicBlock::Create( TheContext, "omp.inc", fn );
+	auto done = BasicBlock::Create( TheContext, "omp.done", fn );
+
+	Builder.SetInsertPoint( entry );
+	if ( TheDebugInfo )
+	{
+		TheDebugInfo->begin_outlined( fn, ast );
+		Builder.SetCurrentDebugLocation( TheDebugInfo->location( ast ) );
+	}
+	auto lo = Builder.CreateAlloca( i64, nullptr, "lo" );
+	auto hi = Builder.CreateAlloca( i64, nullptr, "hi" );
+	auto k = Builder.CreateAlloca( i64, nullptr, "k" );
+
+	symTable.push();
+
+	std::vector<Reduction> reductions;
+	for ( auto &entry : omp.reductions )
+	{
+		auto shared = shared_variable( entry.second, pragma );
+		auto identity = reduction_identity( entry.first, shared.get_type(), pragma );
+		auto partial = declare_private( entry.second, shared.get_type(), ast );
+		Builder.CreateStore( identity, partial );
+		reductions.push_back( Reduction{ entry.first, shared, partial } );
+	}
+	for ( auto &name : omp.privates )
+	{
+		declare_private( name, shared_variable( name, pragma ).get_type(), ast );
+	}
+	for ( auto &name : omp.firstprivates )
+	{
+		auto shared = shared_variable( name, pragma );
+		auto copy = declare_private( name, shared.get_type(), ast );
+		Builder.CreateStore( Builder.CreateLoad( shared.get() ), copy );
+	}
+	auto iv = declare_private( loop.var, type, ast );
+	Builder.CreateBr( next );
+
+	Builder.SetInsertPoint( next );
+	auto more = Builder.CreateCall( workshare_function( "__mcc_omp_next" ), { thread, lo, hi } );
+	Builder.CreateCondBr( more, range, done );
+
+	Builder.SetInsertPoint( range );
+	Builder.CreateStore( Builder.CreateLoad( lo ), k );
+	Builder.CreateBr( cond );
+
+	Builder.SetInsertPoint( cond );
+	Builder.CreateCondBr( Builder.CreateICmpSLT( Builder.CreateLoad( k ), Builder.CreateLoad( hi ) ), body, next );
+
+	Builder.SetInsertPoint( body );
+	auto value = Builder.CreateAdd( start, Builder.CreateMul( Builder.CreateLoad( k ), step ) );
+	Builder.CreateStore( Builder.CreateTrunc( value, type->type ), iv );
+
+	continueJump.emplace( inc );
+	codegen( children[ index ] );
+	continueJump.pop();
+	Builder.CreateBr( inc );
+
+	Builder.SetInsertPoint( inc );
+	Builder.CreateStore( Builder.CreateAdd( Builder.CreateLoad( k ), one ), k );
+	Builder.CreateBr( cond );
+	attach_loop_hints( hints, cond, range );
+
+	// a thread adds its part once it has no more iterations to run
+	Builder.SetInsertPoint( done );
+	if ( !reductions.empty() )
+	{
+		Builder.CreateCall( workshare_function( "__mcc_omp_lock" ) );
+		for ( auto &red : reductions )
+		{
+			auto addr = red.shared.get();
+			auto sum = combine( red.op, Builder.CreateLoad( addr ), Builder.CreateLoad( red.partial ) );
+			Builder.CreateStore( sum, addr );
+		}
+		Builder.CreateCall( workshare_function( "__mcc_omp_unlock" ) );
+	}
+	Builder.CreateRetVoid();
+
+	symTable.pop();
+	if ( TheDebugInfo )
+	{
+		Builder.SetCurrentDebugLocation( DebugLoc() );
+		TheDebugInfo->end_outlined();
+	}
+
+	std::vector<Value *> captures;
+	auto frame_ty = capture_frame( fn, captures );
+
+	currentFunction = saved_fn;
+	Builder.restoreIP( saved_ip );
+	Builder.SetCurrentDebugLocation( saved_loc );
+
+	auto frame = abi::create_temporary( frame_ty, "omp.frame" );
+	for ( unsigned i = 0; i != captures.size(); ++i )
+	{
+		Builder.CreateStore( captures[ i ], Builder.CreateStructGEP( frame_ty, frame, i ) );
+	}
+	Builder.CreateCall( workshare_function( "__mcc_omp_parallel_for" ),
+						{ fn, Builder.CreateBitCast( frame, i8p ), trip, Builder.getInt64( omp.chunk ),
+						  Builder.getInt32( omp.dynamic ), Builder.getInt32( omp.threads ) } );
+
+	// the loop variable is left as if the loop had run here
+	auto last = Builder.CreateAdd( start, Builder.CreateMul( trip, step ) );
+	Builder.CreateStore( Builder.CreateTrunc( last, type->type ), var.get() );
+}
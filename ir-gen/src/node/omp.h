@@ -0,0 +1,8 @@
+#pragma once
+
+#include "pragma.h"
+
+// lowers `for ( var = start; var < bound; var += step ) body` under
+// `#pragma omp parallel for`: the body becomes a function over ranges of
+// iterations, run by the threads of the work-sharing runtime.
+void lower_parallel_for( const LoopHints &hints, Json::Value &children, Json::Value &ast );
@@ -0,0 +1,324 @@
+#include "pragma.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/CFG.h"
+
+#include <set>
+
+static std::vector<std::string> split_pragma( const std::string &text )
+{
+	std::vector<std::string> words;
+	std::string word;
+	for ( auto c : text )
+	{
+		if ( std::isspace( c ) || c == '(' || c == ')' )
+		{
+			if ( !word.empty() ) words.emplace_back( std::move( word ) );
+			word.clear();
+			if ( c == '(' || c == ')' ) words.emplace_back( 1, c );
+		}
+		else
+		{
+			word += c;
+		}
+	}
+	if ( !word.empty() ) words.emplace_back( std::move( word ) );
+	return words;
+}
+
+static bool parse_count( const std::string &text, unsigned &count )
+{
+	char *end;
+	auto val = std::strtoul( text.c_str(), &end, 0 );
+	if ( text.empty() || *end != 0 || val == 0 || val > UINT_MAX ) return false;
+	count = val;
+	return true;
+}
+
+static MDNode *loop_property( const char *name )
+{
+	return MDNode::get( TheContext, MDString::get( TheContext, name ) );
+}
+
+static MDNode *loop_property( const char *name, Constant *value )
+{
+	return MDNode::get( TheContext, { MDString::get( TheContext, name ),
+									  ConstantAsMetadata::get( value ) } );
+}
+
+// options of `#pragma clang loop`
+static bool apply_loop_option( LoopHints &hints, const std::string &option, const std::string &value )
+{
+	auto &props = hints.props;
+	unsigned count;
+
+	if ( option == "vectorize" || option == "interleave" )
+	{
+		if ( value == "enable" || value == "assume_safety" )
+		{
+			props.push_back( loop_property( "llvm.loop.vectorize.enable", Builder.getTrue() ) );
+			hints.parallel = hints.parallel || value == "assume_safety";
+		}
+		else if ( value == "disable" )
+		{
+			props.push_back( option == "vectorize" ? loop_property( "llvm.loop.vectorize.width", Builder.getInt32( 1 ) )
+												   : loop_property( "llvm.loop.interleave.count", Builder.getInt32( 1 ) ) );
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else if ( option == "vectorize_width" && parse_count( value, count ) )
+	{
+		props.push_back( loop_property( "llvm.loop.vectorize.width", Builder.getInt32( count ) ) );
+	}
+	else if ( option == "interleave_count" && parse_count( value, count ) )
+	{
+		props.push_back( loop_property( "llvm.loop.interleave.count", Builder.getInt32( count ) ) );
+	}
+	else if ( option == "unroll" )
+	{
+		if ( value == "enable" ) props.push_back( loop_property( "llvm.loop.unroll.enable" ) );
+		else if ( value == "disable" ) props.push_back( loop_property( "llvm.loop.unroll.disable" ) );
+		else if ( value == "full" ) props.push_back( loop_property( "llvm.loop.unroll.full" ) );
+		else return false;
+	}
+	else if ( option == "unroll_count" && parse_count( value, count ) )
+	{
+		props.push_back( loop_property( "llvm.loop.unroll.count", Builder.getInt32( count ) ) );
+	}
+	else if ( option == "distribute" && ( value == "enable" || value == "disable" ) )
+	{
+		props.push_back( loop_property( "llvm.loop.distribute.enable", Builder.getInt1( value == "enable" ) ) );
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+static std::vector<std::string> split_list( const std::string &text )
+{
+	std::vector<std::string> items;
+	std::size_t start = 0;
+	while ( start <= text.size() )
+	{
+		auto end = std::min( text.find( ',', start ), text.size() );
+		if ( end != start ) items.push_back( text.substr( start, end - start ) );
+		start = end + 1;
+	}
+	return items;
+}
+
+// clauses of `#pragma omp parallel for`, whatever is not private is shared
+static bool apply_omp_clause( OmpLoop &omp, const std::string &clause, const std::string &value )
+{
+	auto items = split_list( value );
+
+	if ( clause == "schedule" && !items.empty() && items.size() <= 2 )
+	{
+		// guided shrinks the chunks as the loop goes on, taking them one by
+		// one is the closest we have
+		if ( items[ 0 ] == "static" ) omp.dynamic = false;
+		else if ( items[ 0 ] == "dynamic" || items[ 0 ] == "guided" ) omp.dynamic = true;
+		else return false;
+		return items.size() == 1 || parse_count( items[ 1 ], omp.chunk );
+	}
+	else if ( clause == "num_threads" && items.size() == 1 )
+	{
+		return parse_count( items[ 0 ], omp.threads );
+	}
+	else if ( clause == "private" || clause == "firstprivate" )
+	{
+		auto &vars = clause == "private" ? omp.privates : omp.firstprivates;
+		vars.insert( vars.end(), items.begin(), items.end() );
+		return !items.empty();
+	}
+	else if ( clause == "reduction" )
+	{
+		static const std::set<std::string> ops = { "+", "-", "*", "&", "|", "^" };
+		auto colon = value.find( ':' );
+		if ( colon == std::string::npos || !ops.count( value.substr( 0, colon ) ) ) return false;
+		auto vars = split_list( value.substr( colon + 1 ) );
+		for ( auto &var : vars ) omp.reductions.emplace_back( value.substr( 0, colon ), var );
+		return !vars.empty();
+	}
+	else if ( clause == "shared" )
+	{
+		return !items.empty();
+	}
+	else if ( clause == "default" )
+	{
+		return value == "shared";
+	}
+	return false;
+}
+
+void parse_loop_pragma( LoopHints &hints, Json::Value &tok )
+{
+	auto words = split_pragma( tok[ 1 ].asString() );
+	auto pos = std::find( words.begin(), words.end(), "pragma" );
+	if ( pos == words.end() ) INTERNAL_ERROR();
+
+	std::vector<std::string> args( pos + 1, words.end() );
+	std::size_t i = 0;
+	auto next = [&]() -> std::string {
+		return i < args.size() ? args[ i++ ] : "";
+	};
+	auto ignore = [&]( const std::string &what ) {
+		infoList->add_msg(
+		  MSG_TYPE_WARNING,
+		  fmt( "ignoring malformed loop pragma `", what, "`" ),
+		  tok );
+	};
+
+	auto kind = next();
+	if ( kind == "GCC" )
+	{
+		kind = next();
+		if ( kind == "ivdep" )
+		{
+			hints.parallel = true;
+			return;
+		}
+	}
+
+	if ( kind == "nounroll" )
+	{
+		hints.props.push_back( loop_property( "llvm.loop.unroll.disable" ) );
+	}
+	else if ( kind == "unroll" )
+	{
+		auto arg = next();
+		if ( arg == "(" ) arg = next();
+		unsigned count;
+		if ( arg.empty() )
+		{
+			hints.props.push_back( loop_property( "llvm.loop.unroll.enable" ) );
+		}
+		else if ( parse_count( arg, count ) )
+		{
+			hints.props.push_back( loop_property( "llvm.loop.unroll.count", Builder.getInt32( count ) ) );
+		}
+		else
+		{
+			ignore( "unroll " + arg );
+		}
+	}
+	else if ( kind == "clang" && next() == "loop" )
+	{
+		while ( i < args.size() )
+		{
+			auto option = next();
+			if ( next() != "(" )
+			{
+				ignore( option );
+				return;
+			}
+			auto value = next();
+			if ( next() != ")" || !apply_loop_option( hints, option, value ) )
+			{
+				ignore( option + "(" + value + ")" );
+			}
+		}
+	}
+	else if ( kind == "omp" && next() == "parallel" && next() == "for" )
+	{
+		OmpLoop omp;
+		omp.pragma = tok;
+		while ( i < args.size() )
+		{
+			auto clause = next();
+			if ( i == args.size() || args[ i ] != "(" )
+			{
+				ignore( clause );
+				continue;
+			}
+			++i;
+			std::string value;
+			for ( auto word = next(); word != ")" && !word.empty(); word = next() )
+			{
+				value += word;
+			}
+			if ( !apply_omp_clause( omp, clause, value ) )
+			{
+				ignore( clause + "(" + value + ")" );
+			}
+		}
+		hints.omp = omp;
+	}
+	else
+	{
+		ignore( kind );
+	}
+}
+
+static void add_access_group( Instruction *inst, MDNode *group )
+{
+	SmallVector<Metadata *, 4> groups;
+	if ( auto prev = inst->getMetadata( "llvm.access.group" ) )
+	{
+		if ( prev->getNumOperands() == 0 )
+		{
+			groups.push_back( prev );
+		}
+		else
+		{
+			groups.append( prev->op_begin(), prev->op_end() );
+		}
+	}
+	groups.push_back( group );
+	inst->setMetadata( "llvm.access.group",
+					   groups.size() == 1 ? group : MDNode::get( TheContext, groups ) );
+}
+
+void attach_loop_hints( const LoopHints &hints, BasicBlock *header, BasicBlock *preheader )
+{
+	if ( hints.empty() ) return;
+
+	std::vector<BasicBlock *> latches;
+	for ( auto pred : predecessors( header ) )
+	{
+		if ( pred != preheader ) latches.push_back( pred );
+	}
+	if ( latches.empty() ) return;
+
+	SmallVector<Metadata *, 8> ops = { nullptr };
+	ops.append( hints.props.begin(), hints.props.end() );
+
+	if ( hints.parallel )
+	{
+		// every block reaching a latch without passing the header
+		SmallPtrSet<BasicBlock *, 16> blocks;
+		blocks.insert( header );
+		blocks.insert( preheader );
+		auto work = latches;
+		while ( !work.empty() )
+		{
+			auto bb = work.back();
+			work.pop_back();
+			if ( !blocks.insert( bb ).second ) continue;
+			for ( auto pred : predecessors( bb ) ) work.push_back( pred );
+		}
+		blocks.erase( preheader );
+
+		auto group = MDNode::getDistinct( TheContext, {} );
+		for ( auto bb : blocks )
+		{
+			for ( auto &inst : *bb )
+			{
+				if ( inst.mayReadOrWriteMemory() ) add_access_group( &inst, group );
+			}
+		}
+		ops.push_back( MDNode::get( TheContext, { MDString::get( TheContext, "llvm.loop.parallel_accesses" ), group } ) );
+	}
+
+	auto loop_id = MDNode::getDistinct( TheContext, ops );
+	loop_id->replaceOperandWith( 0, loop_id );
+	for ( auto latch : latches )
+	{
+		latch->getTerminator()->setMetadata( "llvm.loop", loop_id );
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "predef.h"
+
+// clauses of `#pragma omp parallel for`
+struct OmpLoop
+{
+	Json::Value pragma;
+	bool dynamic = false;  // schedule( dynamic ) and schedule( guided )
+	unsigned chunk = 0;	   // 0 splits the iterations evenly between the threads
+	unsigned threads = 0;  // 0 for OMP_NUM_THREADS or one per cpu
+	std::vector<std::string> privates;
+	std::vector<std::string> firstprivates;
+	std::vector<std::pair<std::string, std::string>> reductions;  // operator and variable
+};
+
+// hints collected from the pragmas in front of a loop, lowered to
+// `llvm.loop` metadata on its latches.
+struct LoopHints
+{
+	std::vector<Metadata *> props;
+	bool parallel = false;	// no loop carried memory dependencies
+	Option<OmpLoop> omp;	// the loop is run by a team of threads
+
+	bool empty() const
+	{
+		return props.empty() && !parallel;
+	}
+};
+
+void parse_loop_pragma( LoopHints &hints, Json::Value &tok );
+void attach_loop_hints( const LoopHints &hints, BasicBlock *header, BasicBlock *preheader );
@@ -1,4 +1,17 @@
 #include "statement.h"
+#include "omp.h"
+#include "pragma.h"
+#include "../debuginfo.h"
+
+// hints of the loop pragmas in front of the loop being lowered
+static LoopHints pendingLoopHints;
+
+static LoopHints take_loop_hints()
+{
+	auto hints = std::move( pendingLoopHints );
+	pendingLoopHints = LoopHints();
+	return hints;
+}
 
 int Statement::reg()
 {
@@ -7,6 +20,7 @@ int Statement::reg()
 			  auto &children = node[ "children" ];
 
 			  symTable.push();
+			  if ( TheDebugInfo ) TheDebugInfo->begin_block( node );
 
 			  // Ignore the { and }
 			  for ( int i = 1; i < children.size() - 1; i++ )
@@ -15,6 +29,7 @@ int Statement::reg()
 			  }
 
 			  //   dbg( symTable );
+			  if ( TheDebugInfo ) TheDebugInfo->end_block();
 			  symTable.pop();
 
 			  return VoidType();
@@ -31,14 +46,22 @@ int Statement::reg()
 		  } ) },
 		{ "iteration_statement", pack_fn<VoidType, VoidType>( []( Json::Value &node, VoidType const & ) -> VoidType {
 			  auto &children = node[ "children" ];
+			  if ( children[ 0 ].isArray() && children[ 0 ][ 0 ].asString() == "LOOP_PRAGMA" )
+			  {
+				  parse_loop_pragma( pendingLoopHints, children[ 0 ] );
+				  return get<VoidType>( codegen( children[ 1 ] ) );
+			  }
+
 			  auto typeIter = children[ 0 ][ 1 ].asCString();
 			  static JumpTable<VoidType( Json::Value & children, Json::Value & ast )> __ = {
 				  { "while", []( Json::Value &children, Json::Value &ast ) -> VoidType {
+					   auto hints = take_loop_hints();
 					   auto func = currentFunction->get();
 					   auto loopEnd = BasicBlock::Create( TheContext, "while.end", static_cast<Function *>( func ) );
 					   auto loopBody = BasicBlock::Create( TheContext, "while.body", static_cast<Function *>( func ), loopEnd );
 					   auto loopCond = BasicBlock::Create( TheContext, "while.cond", static_cast<Function *>( func ), loopBody );
 
+					   auto preheader = Builder.GetInsertBlock();
 					   Builder.CreateBr( loopCond );
 
 					   Builder.SetInsertPoint( loopCond );
@@ -59,16 +82,19 @@ int Statement::reg()
 					   continueJump.pop();
 					   breakJump.pop();
 
+					   attach_loop_hints( hints, loopCond, preheader );
 					   Builder.SetInsertPoint( loopEnd );
 
 					   return VoidType();
 				   } },
 				  { "do", []( Json::Value &children, Json::Value &ast ) -> VoidType {
+					   auto hints = take_loop_hints();
 					   auto func = currentFunction->get();
 					   auto loopEnd = BasicBlock::Create( TheContext, "do.end", static_cast<Function *>( func ) );
 					   auto loopBody = BasicBlock::Create( TheContext, "do.body", static_cast<Function *>( func ), loopEnd );
 					   auto loopCond = BasicBlock::Create( TheContext, "do.cond", static_cast<Function *>( func ), loopBody );
 
+					   auto preheader = Builder.GetInsertBlock();
 					   Builder.CreateBr( loopCond );
 
 					   breakJump.emplace( loopEnd );
@@ -87,11 +113,18 @@ int Statement::reg()
 								   .cast( TypeView::getBoolTy(), children[ 4 ] );
 					   Builder.CreateCondBr( br.get(), loopBody, loopEnd );
 
+					   attach_loop_hints( hints, loopCond, preheader );
 					   Builder.SetInsertPoint( loopEnd );
 
 					   return VoidType();
 				   } },
 				  { "for", []( Json::Value &children, Json::Value &ast ) -> VoidType {
+					   auto hints = take_loop_hints();
+					   if ( hints.omp.is_some() )
+					   {
+						   lower_parallel_for( hints, children, ast );
+						   return VoidType();
+					   }
 					   auto func = currentFunction->get();
 					   auto loopEnd = BasicBlock::Create( TheContext, "for.end", static_cast<Function *>( func ) );
 					   auto loopInc = BasicBlock::Create( TheContext, "for.inc", static_cast<Function *>( func ), loopEnd );
@@ -99,6 +132,7 @@ int Statement::reg()
 					   auto loopCond = BasicBlock::Create( TheContext, "for.cond", static_cast<Function *>( func ), loopBody );
 
 					   codegen( children[ 2 ] );
+					   auto preheader = Builder.GetInsertBlock();
 					   Builder.CreateBr( loopCond );
 
 					   Builder.SetInsertPoint( loopCond );
@@ -120,12 +154,8 @@ int Statement::reg()
 					   if ( children[ 4 ].isObject() )
 					   {
 						   codegen( children[ 4 ] );
-						   Builder.CreateBr( loopCond );
-					   }
-					   else
-					   {
-						   Builder.CreateBr( loopEnd );
 					   }
+					   Builder.CreateBr( loopCond );
 
 					   breakJump.emplace( loopEnd );
 					   continueJump.emplace( loopInc );
@@ -138,6 +168,7 @@ int Statement::reg()
 					   continueJump.pop();
 					   breakJump.pop();
 
+					   attach_loop_hints( hints, loopCond, preheader );
 					   Builder.SetInsertPoint( loopEnd );
 
 					   return VoidType();
@@ -173,7 +204,8 @@ int Statement::reg()
 						   auto retValue = get<QualifiedValue>( codegen( children[ 1 ] ) )
 											 .value( children[ 1 ] )
 											 .cast( fn_res_ty, children[ 1 ] );
-						   Builder.CreateRet( retValue.get() );
+						   abi::emit_return( currentFunction->get_type()->as<mty::Function>()->abi_info(),
+											 retValue.get() );
 					   }
 					   else if ( children.size() == 2 )
 					   {
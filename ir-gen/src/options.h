@@ -0,0 +1,38 @@
+#pragma once
+
+namespace ffi
+{
+constexpr int FP_CONTRACT_OFF = 0;
+constexpr int FP_CONTRACT_ON = 1;  // within an expression
+constexpr int FP_CONTRACT_FAST = 2;  // wherever the optimizer finds it
+
+struct CompileOptions final
+{
+	int debug = 0;
+	int no_builtin = 0;
+	const char *triple = nullptr;
+	int irgen_jobs = 0;
+	int codegen_jobs = 0;
+	int fast_math = 0;
+	int math_errno = 1;
+	int finite_math = 0;
+	int assoc_math = 0;
+	int fp_contract = FP_CONTRACT_OFF;
+	const char *profile_generate = nullptr;  // directory of the raw profiles, "" for the working one
+	const char *profile_use = nullptr;
+	const char *profile_sample_use = nullptr;
+	int debug_info = 0;
+	int no_omit_frame_pointer = 0;
+	int xray_instrument = 0;
+	int xray_threshold = 200;  // instructions a function needs to be instrumented
+	const char *xray_always = nullptr;  // special case lists of function names
+	const char *xray_never = nullptr;
+	const char *rpass = nullptr;  // regex of the passes whose remarks are reported
+	const char *rpass_missed = nullptr;
+	const char *rpass_analysis = nullptr;
+	int save_opt_record = 0;
+	const char *cpu = nullptr;  // null for a generic one
+	int mca_report = 0;
+};
+
+}  // namespace ffi
@@ -0,0 +1,277 @@
+#include "parallel.h"
+#include "debuginfo.h"
+#include "workshare.h"
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ir-gen keeps its state in globals, so instead of threads every worker is
+// a fork of the compiler right after the top level declarations. A worker
+// generates its share of the bodies and replies with its diagnostics and,
+// if nothing halted it, its module as bitcode:
+//
+//   u64 count, { i32 type, i32 has_loc, u64 pos[ 4 ], u64 len, char msg[ len ] } * count,
+//   u8 ok, u64 len, char bitcode[ len ]
+
+template <typename T>
+static void put( std::string &buf, const T &val )
+{
+	buf.append( reinterpret_cast<const char *>( &val ), sizeof( val ) );
+}
+
+template <typename T>
+static bool take( StringRef &buf, T &val )
+{
+	if ( buf.size() < sizeof( val ) ) return false;
+	memcpy( &val, buf.data(), sizeof( val ) );
+	buf = buf.drop_front( sizeof( val ) );
+	return true;
+}
+
+static bool take( StringRef &buf, std::string &val )
+{
+	uint64_t len;
+	if ( !take( buf, len ) || buf.size() < len ) return false;
+	val = buf.take_front( len ).str();
+	buf = buf.drop_front( len );
+	return true;
+}
+
+static void write_all( int fd, const std::string &buf )
+{
+	for ( std::size_t off = 0; off < buf.size(); )
+	{
+		auto n = ::write( fd, buf.data() + off, buf.size() - off );
+		if ( n < 0 && errno == EINTR ) continue;
+		if ( n <= 0 ) return;
+		off += n;
+	}
+}
+
+static std::string read_all( int fd )
+{
+	std::string buf;
+	char chunk[ 1 << 16 ];
+	while ( true )
+	{
+		auto n = ::read( fd, chunk, sizeof( chunk ) );
+		if ( n < 0 && errno == EINTR ) continue;
+		if ( n <= 0 ) break;
+		buf.append( chunk, n );
+	}
+	return buf;
+}
+
+[[noreturn]] static void run_worker( int fd, int index, int jobs,
+									 const std::vector<FunctionDefinition> &defs,
+									 const std::function<void( const FunctionDefinition & )> &define )
+{
+	// diagnostics so far are reported by the parent
+	infoList->clear();
+
+	std::vector<GlobalVariable *> vars;
+	std::vector<Function *> fns;
+	for ( auto &var : TheModule->globals() ) vars.push_back( &var );
+	for ( auto &fn : TheModule->functions() ) fns.push_back( &fn );
+
+	std::string bitcode;
+	bool ok = secure_exec( [&] {
+		for ( auto i = index; i < defs.size(); i += jobs )
+		{
+			symTable.rewind( defs[ i ].scope_mark );
+			define( defs[ i ] );
+		}
+
+		// the parent owns everything that existed before the fork
+		for ( auto var : vars )
+		{
+			var->setLinkage( GlobalValue::ExternalLinkage );
+			var->setInitializer( nullptr );
+			var->eraseMetadata( LLVMContext::MD_dbg );
+		}
+		for ( auto fn : fns )
+		{
+			if ( !fn->isDeclaration() ) fn->deleteBody();
+		}
+		define_workshare_runtime();
+		// the compile unit comes back as a copy of its own, like the
+		// modules of a link time optimization
+		if ( TheDebugInfo ) TheDebugInfo->finalize();
+
+		raw_string_ostream os( bitcode );
+		WriteBitcodeToFile( *TheModule, os );
+		os.flush();
+	} );
+
+	std::string reply;
+	put( reply, uint64_t( infoList->len ) );
+	for ( auto i = 0; i < infoList->len; ++i )
+	{
+		auto &msg = infoList->msgs[ i ];
+		put( reply, int32_t( msg.type ) );
+		put( reply, int32_t( msg.has_loc ) );
+		for ( auto pos : msg.pos ) put( reply, uint64_t( pos ) );
+		put( reply, uint64_t( strlen( msg.msg ) ) );
+		reply += msg.msg;
+	}
+	put( reply, uint8_t( ok ) );
+	put( reply, uint64_t( bitcode.size() ) );
+	reply += bitcode;
+
+	write_all( fd, reply );
+	_exit( 0 );
+}
+
+// moves the diagnostics of a reply to infoList, false if it is truncated
+static bool read_reply( StringRef buf, bool &ok, std::string &bitcode )
+{
+	uint64_t count;
+	if ( !take( buf, count ) ) return false;
+	for ( uint64_t i = 0; i < count; ++i )
+	{
+		int32_t type, has_loc;
+		uint64_t pos[ 4 ];
+		std::string msg;
+		if ( !take( buf, type ) || !take( buf, has_loc ) || !take( buf, pos ) || !take( buf, msg ) )
+		{
+			return false;
+		}
+		if ( has_loc )
+		{
+			const std::size_t loc[ 4 ] = { pos[ 0 ], pos[ 1 ], pos[ 2 ], pos[ 3 ] };
+			infoList->add_msg( type, msg, loc );
+		}
+		else
+		{
+			infoList->add_msg( type, msg );
+		}
+	}
+	uint8_t done;
+	if ( !take( buf, done ) || !take( buf, bitcode ) ) return false;
+	ok = done != 0;
+	return true;
+}
+
+static void define_in_workers( const std::vector<FunctionDefinition> &defs, int jobs,
+							   const std::function<void( const FunctionDefinition & )> &define )
+{
+	// workers refer to the parent's globals by name, so those local to the
+	// module are made visible while they are linked back
+	std::vector<std::pair<GlobalVariable *, GlobalValue::LinkageTypes>> locals;
+	std::vector<GlobalVariable *> unnamed;
+	for ( auto &var : TheModule->globals() )
+	{
+		if ( !var.hasLocalLinkage() ) continue;
+		locals.emplace_back( &var, var.getLinkage() );
+		if ( !var.hasName() )
+		{
+			var.setName( ".mcc.local" );
+			unnamed.push_back( &var );
+		}
+		var.setLinkage( GlobalValue::ExternalLinkage );
+	}
+	auto restore = [&] {
+		for ( auto &local : locals ) local.first->setLinkage( local.second );
+		for ( auto var : unnamed ) var->setName( "" );
+	};
+
+	std::vector<std::pair<pid_t, int>> workers;
+	auto reap = [&] {
+		for ( auto &worker : workers )
+		{
+			close( worker.second );
+			while ( waitpid( worker.first, nullptr, 0 ) < 0 && errno == EINTR )
+				;
+		}
+	};
+	for ( auto k = 0; k < jobs; ++k )
+	{
+		int fds[ 2 ];
+		pid_t pid = -1;
+		if ( pipe( fds ) == 0 )
+		{
+			pid = fork();
+			if ( pid == 0 )
+			{
+				close( fds[ 0 ] );
+				run_worker( fds[ 1 ], k, jobs, defs, define );
+			}
+			close( fds[ 1 ] );
+			if ( pid < 0 ) close( fds[ 0 ] );
+		}
+		if ( pid < 0 )
+		{
+			auto err = std::string( strerror( errno ) );
+			reap();
+			restore();
+			INTERNAL_ERROR( "cannot start an ir-gen worker: ", err );
+		}
+		workers.emplace_back( pid, fds[ 0 ] );
+	}
+
+	// replies are read in order, a worker that is done early just waits on its pipe
+	bool ok = true;
+	std::vector<std::string> modules( jobs );
+	for ( auto k = 0; k < jobs; ++k )
+	{
+		auto reply = read_all( workers[ k ].second );
+		bool done;
+		if ( !read_reply( reply, done, modules[ k ] ) )
+		{
+			infoList->add_msg( MSG_TYPE_ERROR,
+							   fmt( "internal error: ir-gen worker ", k, " exited abnormally" ) );
+			done = false;
+		}
+		ok = ok && done;
+	}
+	reap();
+
+	if ( ok )
+	{
+		for ( auto &bitcode : modules )
+		{
+			auto buf = MemoryBuffer::getMemBufferCopy( bitcode, "ir-gen worker" );
+			auto module = parseBitcodeFile( buf->getMemBufferRef(), TheContext );
+			if ( !module )
+			{
+				restore();
+				INTERNAL_ERROR( "cannot read the module of an ir-gen worker: ", toString( module.takeError() ) );
+			}
+			if ( Linker::linkModules( *TheModule, std::move( *module ) ) )
+			{
+				restore();
+				INTERNAL_ERROR( "cannot link the module of an ir-gen worker" );
+			}
+		}
+	}
+	restore();
+
+	if ( !ok ) HALT();
+}
+#endif
+
+void define_functions( const std::vector<FunctionDefinition> &defs, int jobs,
+					   const std::function<void( const FunctionDefinition & )> &define )
+{
+	if ( jobs > defs.size() ) jobs = defs.size();
+#ifndef _WIN32
+	if ( jobs > 1 )
+	{
+		define_in_workers( defs, jobs, define );
+		return;
+	}
+#endif
+	for ( auto &def : defs )
+	{
+		symTable.rewind( def.scope_mark );
+		define( def );
+	}
+	symTable.rewind( symTable.mark() );
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "global.h"
+
+// a function whose prototype is already in TheModule and the symbol table,
+// its body is generated later on
+struct FunctionDefinition
+{
+	Json::Value *node;
+	QualifiedType type;
+	std::string name;
+	Function *fn;
+	std::size_t scope_mark;	 // the file scope as its body sees it
+};
+
+// generates the body of every definition with `define`, spread over
+// `jobs` forked workers whose modules are linked back into TheModule.
+// Each body sees the file scope rewound to its own `scope_mark`, so the
+// declarations after it are not visible, as in a serial run
+void define_functions( const std::vector<FunctionDefinition> &defs, int jobs,
+					   const std::function<void( const FunctionDefinition & )> &define );
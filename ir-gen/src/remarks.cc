@@ -0,0 +1,108 @@
+#include "remarks.h"
+#include "debuginfo.h"
+#include "global.h"
+
+#include "llvm/IR/DiagnosticHandler.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/YAMLTraits.h"
+
+class RemarkHandler : public DiagnosticHandler
+{
+	// shared since the checks below are const and matching is not
+	std::shared_ptr<Regex> passed, missed, analysis;
+
+	static std::shared_ptr<Regex> compile( const char *flag, const char *pattern )
+	{
+		if ( !pattern ) return nullptr;
+		auto regex = std::make_shared<Regex>( pattern );
+		std::string err;
+		if ( !regex->isValid( err ) )
+		{
+			infoList->add_msg( MSG_TYPE_ERROR, fmt( "invalid regular expression in ", flag, ": ", err ) );
+			HALT();
+		}
+		return regex;
+	}
+
+public:
+	RemarkHandler() :
+	  passed( compile( "-Rpass", compileOptions.rpass ) ),
+	  missed( compile( "-Rpass-missed", compileOptions.rpass_missed ) ),
+	  analysis( compile( "-Rpass-analysis", compileOptions.rpass_analysis ) )
+	{
+	}
+
+	bool isPassedOptRemarkEnabled( StringRef pass ) const override
+	{
+		return passed && passed->match( pass );
+	}
+	bool isMissedOptRemarkEnabled( StringRef pass ) const override
+	{
+		return missed && missed->match( pass );
+	}
+	bool isAnalysisRemarkEnabled( StringRef pass ) const override
+	{
+		return analysis && analysis->match( pass );
+	}
+
+	bool handleDiagnostics( const DiagnosticInfo &info ) override
+	{
+		// everything else is reported by llvm itself
+		auto remark = dyn_cast<DiagnosticInfoOptimizationBase>( &info );
+		if ( !remark ) return false;
+		if ( !remark->isEnabled() ) return true;
+
+		const char *flag;
+		switch ( remark->getKind() )
+		{
+		case DK_OptimizationRemark:
+		case DK_MachineOptimizationRemark: flag = "-Rpass"; break;
+		case DK_OptimizationRemarkMissed:
+		case DK_MachineOptimizationRemarkMissed: flag = "-Rpass-missed"; break;
+		default: flag = "-Rpass-analysis"; break;
+		}
+		auto msg = fmt( remark->getMsg(), " [", flag, "=", remark->getPassName().str(), "]" );
+
+		std::size_t pos[ 4 ];
+		if ( TheDebugInfo && remark->isLocationAvailable() &&
+			 TheDebugInfo->find_position( remark->getLocation().getRelativePath(),
+										  remark->getLocation().getLine(),
+										  remark->getLocation().getColumn(), pos ) )
+		{
+			infoList->add_msg( MSG_TYPE_REMARK, msg, pos );
+		}
+		else
+		{
+			infoList->add_msg( MSG_TYPE_REMARK, fmt( remark->getFunction().getName().str(), ": ", msg ) );
+		}
+		return true;
+	}
+};
+
+void setup_remarks()
+{
+	TheContext.setDiagnosticHandler( make_unique<RemarkHandler>() );
+}
+
+RemarkRecord::RemarkRecord( const char *path )
+{
+	if ( !compileOptions.save_opt_record || !path ) return;
+	std::error_code errc;
+	file = make_unique<ToolOutputFile>( path, errc, sys::fs::F_None );
+	if ( errc )
+	{
+		infoList->add_msg( MSG_TYPE_WARNING, fmt( "cannot write optimization record ", path, ": ", errc.message() ) );
+		file = nullptr;
+		return;
+	}
+	TheContext.setDiagnosticsOutputFile( make_unique<yaml::Output>( file->os() ) );
+}
+
+RemarkRecord::~RemarkRecord()
+{
+	if ( !file ) return;
+	TheContext.setDiagnosticsOutputFile( nullptr );
+	file->keep();
+}
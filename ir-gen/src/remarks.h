@@ -0,0 +1,23 @@
+#pragma once
+
+#include "common.h"
+
+namespace llvm
+{
+class ToolOutputFile;
+}
+
+// reports the optimization remarks -Rpass, -Rpass-missed and -Rpass-analysis
+// ask for through infoList, at the source position of the remark
+void setup_remarks();
+
+// -fsave-optimization-record, every remark of a codegen run is written to
+// `path` as yaml while this is alive
+class RemarkRecord
+{
+	std::unique_ptr<llvm::ToolOutputFile> file;
+
+public:
+	RemarkRecord( const char *path );
+	~RemarkRecord();
+};
@@ -89,9 +89,16 @@ public:
 	{
 		auto &smap = scopes.back();
 		const T val = type;
+		Option<T> before;
 		if ( auto old = find_in_scope( str ) )
 		{
 			if ( !cmp_when( str, *old, val, node ) ) return;
+			before = *old;
+		}
+		if ( keep_journal && get_scope() == journal_scope )
+		{
+			journal.push_back( Change{ str, before, val } );
+			journal_pos = journal.size();
 		}
 		if ( smap.find( str ) != smap.end() )
 		{
@@ -115,6 +122,40 @@ public:
 		return scopes.size() - 1;
 	}
 
+	// from here on, changes to the current scope are recorded so that it
+	// can be rewound to how it was at any mark()
+	void start_journal()
+	{
+		keep_journal = true;
+		journal_scope = get_scope();
+	}
+
+	std::size_t mark() const
+	{
+		return journal.size();
+	}
+
+	// undoes or redoes the recorded changes up to `pos`, what was inserted
+	// into the scope since and not recorded is kept
+	void rewind( std::size_t pos )
+	{
+		auto &smap = scopes[ journal_scope ];
+		auto set = [&]( const std::string &name, const Option<T> &val ) {
+			smap.erase( name );
+			if ( val.is_some() ) smap.emplace( name, val.unwrap() );
+		};
+		for ( ; journal_pos > pos; --journal_pos )
+		{
+			auto &change = journal[ journal_pos - 1 ];
+			set( change.name, change.before );
+		}
+		for ( ; journal_pos < pos; ++journal_pos )
+		{
+			auto &change = journal[ journal_pos ];
+			set( change.name, change.after );
+		}
+	}
+
 	friend std::ostream &operator<<( std::ostream &os, ScopedMap &symTable )
 	{
 		int level = symTable.get_scope();
@@ -140,5 +181,15 @@ public:
 	}
 
 private:
+	struct Change
+	{
+		std::string name;
+		Option<T> before, after;
+	};
+
 	std::deque<std::map<std::string, T>> scopes;
+	bool keep_journal = false;
+	int journal_scope = 0;
+	std::vector<Change> journal;
+	std::size_t journal_pos = 0;
 };
@@ -0,0 +1,205 @@
+#include "target.h"
+#include "be.h"
+#include "global.h"
+#include "type/def.h"
+
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+std::unique_ptr<TargetInfo> TheTargetInfo;
+
+static TargetMachine *new_machine( const Target *target, const std::string &triple )
+{
+	auto cpu = compileOptions.cpu ? compileOptions.cpu : "generic";
+	auto features = "";
+
+	TargetOptions opt;
+	opt.UnsafeFPMath = compileOptions.fast_math;
+	opt.NoInfsFPMath = opt.NoNaNsFPMath = compileOptions.finite_math || compileOptions.fast_math;
+	switch ( compileOptions.fp_contract )
+	{
+	case FP_CONTRACT_OFF: opt.AllowFPOpFusion = FPOpFusion::Strict; break;
+	case FP_CONTRACT_ON: opt.AllowFPOpFusion = FPOpFusion::Standard; break;  // fuses llvm.fmuladd only
+	case FP_CONTRACT_FAST: opt.AllowFPOpFusion = FPOpFusion::Fast; break;
+	}
+	auto rm = Optional<Reloc::Model>();
+	return target->createTargetMachine( triple, cpu, features, opt, rm );
+}
+
+std::unique_ptr<TargetInfo> TargetInfo::create( const std::string &triple, std::string &err )
+{
+	auto target = lookup_target( triple, err );
+	if ( !target )
+	{
+		return nullptr;
+	}
+	std::unique_ptr<TargetMachine> machine( new_machine( target, triple ) );
+	return make_unique<TargetInfo>( target, triple, machine->createDataLayout() );
+}
+
+TargetInfo::TargetInfo( const Target *target, const std::string &triple, const DataLayout &layout ) :
+  target( target ),
+  triple( triple ),
+  layout( layout )
+{
+	for ( auto is_signed : { false, true } )
+	{
+		long_ty[ is_signed ] = make_unique<TypeView>( std::make_shared<QualifiedType>(
+		  std::make_shared<mty::Integer>( long_width(), is_signed ) ) );
+		// `long` unless it is narrower than a pointer (LLP64)
+		ptrdiff_ty[ is_signed ] = make_unique<TypeView>(
+		  long_width() < layout.getPointerSizeInBits() ? TypeView::getLongLongTy( is_signed )
+													   : *long_ty[ is_signed ] );
+	}
+}
+
+TargetInfo::~TargetInfo() = default;
+
+TargetMachine *TargetInfo::create_machine() const
+{
+	return new_machine( target, triple );
+}
+
+unsigned TargetInfo::long_width() const
+{
+	return Triple( triple ).isOSWindows() ? 32 : layout.getPointerSizeInBits();
+}
+
+bool TargetInfo::has_sysv_x86_64_abi() const
+{
+	Triple t( triple );
+	return t.getArch() == Triple::x86_64 && !t.isOSWindows();
+}
+
+const TypeView &TargetInfo::long_type( bool is_signed ) const
+{
+	return *long_ty[ is_signed ];
+}
+
+const TypeView &TargetInfo::ptrdiff_type( bool is_signed ) const
+{
+	return *ptrdiff_ty[ is_signed ];
+}
+
+Type *TargetInfo::long_double_type() const
+{
+	Triple t( triple );
+	if ( t.isWindowsMSVCEnvironment() || ( t.isOSDarwin() && t.getArch() == Triple::aarch64 ) )
+	{
+		return Type::getDoubleTy( TheContext );
+	}
+	switch ( t.getArch() )
+	{
+	case Triple::x86:
+	case Triple::x86_64: return Type::getX86_FP80Ty( TheContext );
+	case Triple::ppc:
+	case Triple::ppc64:
+	case Triple::ppc64le: return Type::getPPC_FP128Ty( TheContext );
+	case Triple::aarch64:
+	case Triple::aarch64_be:
+	case Triple::riscv64:
+	case Triple::mips64:
+	case Triple::mips64el:
+	case Triple::systemz:
+	case Triple::sparcv9: return Type::getFP128Ty( TheContext );
+	default: return Type::getDoubleTy( TheContext );
+	}
+}
+
+FastMathFlags TargetInfo::fast_math_flags() const
+{
+	FastMathFlags flags;
+	if ( compileOptions.fast_math )
+	{
+		flags.setFast();
+		return flags;
+	}
+	if ( compileOptions.finite_math )
+	{
+		flags.setNoNaNs();
+		flags.setNoInfs();
+	}
+	if ( compileOptions.assoc_math ) flags.setAllowReassoc();
+	if ( compileOptions.fp_contract == FP_CONTRACT_FAST ) flags.setAllowContract();
+	return flags;
+}
+
+void TargetInfo::set_fp_attributes( Function *fn ) const
+{
+	auto finite = compileOptions.finite_math || compileOptions.fast_math;
+	fn->addFnAttr( "unsafe-fp-math", compileOptions.fast_math ? "true" : "false" );
+	fn->addFnAttr( "no-infs-fp-math", finite ? "true" : "false" );
+	fn->addFnAttr( "no-nans-fp-math", finite ? "true" : "false" );
+}
+
+std::vector<Type *> TargetInfo::union_body( const std::vector<Type *> &members ) const
+{
+	Type *align_ty = nullptr;
+	uint64_t size = 0;
+	unsigned align = 0;
+
+	for ( auto member : members )
+	{
+		auto member_size = layout.getTypeAllocSize( member );
+		if ( !member_size ) continue;
+		auto member_align = layout.getABITypeAlignment( member );
+		if ( member_align > align ||
+			 ( member_align == align && member_size > layout.getTypeAllocSize( align_ty ) ) )
+		{
+			align_ty = member;
+			align = member_align;
+		}
+		size = std::max( size, member_size );
+	}
+
+	std::vector<Type *> body;
+	if ( align_ty )
+	{
+		body.emplace_back( align_ty );
+		auto padding = alignTo( size, align ) - layout.getTypeAllocSize( align_ty );
+		if ( padding )
+		{
+			body.emplace_back( ArrayType::get( Type::getInt8Ty( TheContext ), padding ) );
+		}
+	}
+	return body;
+}
+
+void TargetInfo::set_alignments( Module &module ) const
+{
+	for ( auto &var : module.globals() )
+	{
+		if ( !var.getAlignment() && var.getValueType()->isSized() )
+		{
+			var.setAlignment( layout.getPreferredAlignment( &var ) );
+		}
+	}
+	for ( auto &fn : module )
+	{
+		for ( auto &block : fn )
+		{
+			for ( auto &inst : block )
+			{
+				if ( auto load = dyn_cast<LoadInst>( &inst ) )
+				{
+					if ( !load->getAlignment() )
+						load->setAlignment( layout.getABITypeAlignment( load->getType() ) );
+				}
+				else if ( auto store = dyn_cast<StoreInst>( &inst ) )
+				{
+					if ( !store->getAlignment() )
+						store->setAlignment( layout.getABITypeAlignment( store->getValueOperand()->getType() ) );
+				}
+				else if ( auto alloca = dyn_cast<AllocaInst>( &inst ) )
+				{
+					if ( !alloca->getAlignment() )
+						alloca->setAlignment( layout.getPrefTypeAlignment( alloca->getAllocatedType() ) );
+				}
+			}
+		}
+	}
+}
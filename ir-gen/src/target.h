@@ -0,0 +1,66 @@
+#pragma once
+
+#include "common.h"
+
+namespace llvm
+{
+class Target;
+class TargetMachine;
+}
+
+class TypeView;
+
+// what the selected target decides about C: the data layout, the width of
+// the integer types and how aggregates are laid out. Set up before ir
+// generation so every size and alignment is the one the backend uses.
+class TargetInfo
+{
+	const llvm::Target *target;
+
+public:
+	const std::string triple;
+	const DataLayout layout;
+
+	TargetInfo( const llvm::Target *target, const std::string &triple, const DataLayout &layout );
+	~TargetInfo();
+
+	// null and `err` set if there is no backend for `triple`
+	static std::unique_ptr<TargetInfo> create( const std::string &triple, std::string &err );
+
+	// a fresh machine, each codegen run or thread needs its own
+	llvm::TargetMachine *create_machine() const;
+
+	// `long` is as wide as a pointer except on windows (LLP64)
+	unsigned long_width() const;
+
+	// `long` and `ptrdiff_t` (also `size_t`) of the target
+	const TypeView &long_type( bool is_signed ) const;
+	const TypeView &ptrdiff_type( bool is_signed ) const;
+
+	// whether aggregates follow the x86-64 System V calling convention,
+	// elsewhere they are passed `byval` and returned through `sret`
+	bool has_sysv_x86_64_abi() const;
+
+	// the hardware format of `long double` where there is one, so it
+	// does not go through the soft float runtime
+	Type *long_double_type() const;
+
+	// body of a union: its most aligned member, padded up to the size
+	// of the largest one rounded to that alignment
+	std::vector<Type *> union_body( const std::vector<Type *> &members ) const;
+
+	// flags of floating point operations under the -f options of the compile
+	FastMathFlags fast_math_flags() const;
+
+	// string attributes the backend reads the same options from
+	void set_fp_attributes( Function *fn ) const;
+
+	// makes the alignment of every memory operation explicit
+	void set_alignments( Module &module ) const;
+
+private:
+	// unsigned at [ 0 ], signed at [ 1 ]
+	std::unique_ptr<TypeView> long_ty[ 2 ], ptrdiff_ty[ 2 ];
+};
+
+extern std::unique_ptr<TargetInfo> TheTargetInfo;
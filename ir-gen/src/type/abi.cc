@@ -0,0 +1,439 @@
+#include "def.h"
+#include "abi.h"
+#include "../global.h"
+#include "../target.h"
+
+namespace abi
+{
+enum ArgClass
+{
+	NoClass,
+	Integer,
+	SSE,
+	SSEUp,	// upper half of a 16 byte vector, passed in the same register
+	X87,	// `long double`, only ever returned in a register ( st0 )
+	X87Up,	// its upper eightbyte
+	ComplexX87,  // `_Complex long double`, there are no complex types yet
+	Memory
+};
+
+static bool is_x87( ArgClass cls )
+{
+	return cls == X87 || cls == X87Up || cls == ComplexX87;
+}
+
+struct Eightbyte
+{
+	ArgClass cls = NoClass;
+	bool has_double = false;
+	Type *vector = nullptr;
+};
+
+static ArgClass merge( ArgClass a, ArgClass b )
+{
+	if ( a == b || b == NoClass ) return a;
+	if ( a == NoClass ) return b;
+	if ( a == Memory || b == Memory ) return Memory;
+	if ( a == Integer || b == Integer ) return Integer;
+	if ( is_x87( a ) || is_x87( b ) ) return Memory;
+	return SSE;
+}
+
+static void classify( const mty::Qualified *type, uint64_t offset, Eightbyte *eb );
+
+static void classify( TypeView view, uint64_t offset, Eightbyte *eb )
+{
+	if ( auto arr = view->as<mty::Array>() )
+	{
+		auto len = arr->len.is_some() ? arr->len.unwrap() : 0;
+		view.next();
+		auto elem_size = TheDataLayout->getTypeAllocSize( view->type );
+		for ( std::size_t i = 0; i != len; ++i )
+		{
+			classify( view, offset + i * elem_size, eb );
+		}
+	}
+	else
+	{
+		classify( view.get(), offset, eb );
+	}
+}
+
+static void classify( const mty::Qualified *type, uint64_t offset, Eightbyte *eb )
+{
+	if ( auto struct_ty = type->as<mty::Struct>() )
+	{
+		auto layout = TheDataLayout->getStructLayout( static_cast<StructType *>( type->type ) );
+		auto &comps = struct_ty->decl->sel_comps;
+		for ( unsigned i = 0; i != comps.size(); ++i )
+		{
+			classify( TypeView( std::make_shared<QualifiedType>( comps[ i ].type ) ),
+					  offset + layout->getElementOffset( i ), eb );
+		}
+	}
+	else if ( auto union_ty = type->as<mty::Union>() )
+	{
+		for ( auto &comp : union_ty->decl->comps )
+		{
+			classify( TypeView( std::make_shared<QualifiedType>( comp.second ) ), offset, eb );
+		}
+	}
+	else if ( type->type->isVectorTy() )
+	{
+		auto size = TheDataLayout->getTypeAllocSize( type->type );
+		for ( auto off = offset; off < offset + size; off += 8 )
+		{
+			auto &item = eb[ off / 8 ];
+			item.cls = merge( item.cls, off == offset ? SSE : SSEUp );
+			item.has_double = item.has_double || type->type->getScalarType()->isDoubleTy();
+		}
+		if ( size == 16 ) eb[ 0 ].vector = type->type;
+	}
+	else if ( type->type->isX86_FP80Ty() )
+	{
+		if ( offset % TheDataLayout->getABITypeAlignment( type->type ) != 0 )
+		{
+			eb[ offset / 8 ].cls = Memory;  // unaligned field
+			return;
+		}
+		eb[ offset / 8 ].cls = merge( eb[ offset / 8 ].cls, X87 );
+		eb[ offset / 8 + 1 ].cls = merge( eb[ offset / 8 + 1 ].cls, X87Up );
+	}
+	else
+	{
+		auto cls = Integer;
+		if ( type->type->isFloatTy() || type->type->isDoubleTy() )
+		{
+			cls = SSE;
+		}
+		else if ( type->type->isFloatingPointTy() )
+		{
+			cls = Memory;  // a 128 bit long double
+		}
+		if ( offset % TheDataLayout->getABITypeAlignment( type->type ) != 0 )
+		{
+			cls = Memory;  // unaligned field
+		}
+		auto &item = eb[ offset / 8 ];
+		item.cls = merge( item.cls, cls );
+		item.has_double = item.has_double || type->type->isDoubleTy();
+	}
+}
+
+static bool is_aggregate( const mty::Qualified *type )
+{
+	return type->is<mty::Structural>() && type->is_complete() &&
+		   TheDataLayout->getTypeAllocSize( type->type ) != 0;
+}
+
+// returns false if the aggregate must be passed or returned in memory
+static bool classify_aggregate( const mty::Qualified *type, Eightbyte *eb, bool is_return )
+{
+	if ( TheDataLayout->getTypeAllocSize( type->type ) > 16 ) return false;
+	classify( type, 0, eb );
+	// x87 registers only hold a whole `long double`, and only results
+	if ( eb[ 1 ].cls == X87Up && eb[ 0 ].cls != X87 ) return false;
+	for ( unsigned i = 0; i != 2; ++i )
+	{
+		if ( eb[ i ].cls == Memory || ( !is_return && is_x87( eb[ i ].cls ) ) ) return false;
+	}
+	return true;
+}
+
+static Type *get_eightbyte_type( const Eightbyte &eb, uint64_t bytes )
+{
+	if ( eb.cls == SSE )
+	{
+		if ( eb.has_double ) return Type::getDoubleTy( TheContext );
+		if ( bytes <= 4 ) return Type::getFloatTy( TheContext );
+		return VectorType::get( Type::getFloatTy( TheContext ), 2 );
+	}
+	return Type::getIntNTy( TheContext, bytes * 8 );
+}
+
+static Type *get_coerce_type( Type *type, const Eightbyte *eb )
+{
+	auto size = TheDataLayout->getTypeAllocSize( type );
+	if ( eb[ 0 ].cls == X87 ) return Type::getX86_FP80Ty( TheContext );
+	if ( eb[ 1 ].cls == SSEUp && eb[ 0 ].vector ) return eb[ 0 ].vector;
+	auto lo = get_eightbyte_type( eb[ 0 ], std::min<uint64_t>( size, 8 ) );
+	if ( size <= 8 ) return lo;
+	auto hi = get_eightbyte_type( eb[ 1 ], size - 8 );
+	return StructType::get( TheContext, { lo, hi } );
+}
+
+FunctionInfo classify_function( const mty::Qualified *ret, const std::vector<QualifiedDecl> &args, bool is_va_args )
+{
+	FunctionInfo info;
+	std::vector<Type *> params;
+	unsigned free_int = 6, free_sse = 8;
+	auto is_sysv = TheTargetInfo->has_sysv_x86_64_abi();
+
+	auto ret_type = ret->type;
+	if ( is_aggregate( ret ) )
+	{
+		Eightbyte eb[ 2 ];
+		if ( is_sysv && classify_aggregate( ret, eb, true ) )
+		{
+			info.ret.kind = Coerce;
+			info.ret.coerce_type = ret_type = get_coerce_type( ret->type, eb );
+		}
+		else
+		{
+			info.ret.kind = Indirect;
+			params.push_back( PointerType::getUnqual( ret->type ) );
+			ret_type = Type::getVoidTy( TheContext );
+			free_int--;
+		}
+	}
+
+	for ( auto &arg : args )
+	{
+		ArgInfo arg_info;
+		auto type = arg.type->type;
+		if ( is_aggregate( arg.type.get() ) )
+		{
+			Eightbyte eb[ 2 ];
+			unsigned need_int = 0, need_sse = 0;
+			auto in_regs = is_sysv && classify_aggregate( arg.type.get(), eb, false );
+			for ( auto &item : eb )
+			{
+				if ( item.cls == SSE ) need_sse++;
+				else if ( item.cls == Integer ) need_int++;
+			}
+			// an aggregate is never split between registers and stack
+			if ( in_regs && need_int <= free_int && need_sse <= free_sse )
+			{
+				free_int -= need_int;
+				free_sse -= need_sse;
+				arg_info.kind = Coerce;
+				arg_info.coerce_type = type = get_coerce_type( type, eb );
+			}
+			else
+			{
+				arg_info.kind = Indirect;
+				arg_info.align = TheDataLayout->getABITypeAlignment( type );
+				if ( is_sysv ) arg_info.align = std::max<unsigned>( arg_info.align, 8 );  // stack slots are eightbytes
+				type = PointerType::getUnqual( type );
+			}
+		}
+		else if ( type->isVectorTy() && TheDataLayout->getTypeAllocSize( type ) > 16 )
+		{
+			// wider than an xmm register, passed in memory
+		}
+		else if ( ( type->isFloatingPointTy() && !type->isX86_FP80Ty() ) || type->isVectorTy() )
+		{
+			if ( free_sse ) free_sse--;
+		}
+		else if ( type->isIntegerTy() || type->isPointerTy() )
+		{
+			// a 128 bit integer takes a pair of registers or none
+			unsigned need = type->isIntegerTy( 128 ) ? 2 : 1;
+			if ( need <= free_int ) free_int -= need;
+		}
+		info.args.push_back( arg_info );
+		params.push_back( type );
+	}
+
+	info.type = llvm::FunctionType::get( ret_type, params, is_va_args );
+	return info;
+}
+
+template <typename T>
+static void apply_attributes_impl( T *target, const FunctionInfo &info )
+{
+	if ( info.ret.kind == Indirect )
+	{
+		target->addParamAttr( 0, Attribute::StructRet );
+		target->addParamAttr( 0, Attribute::NoAlias );
+	}
+	for ( unsigned i = 0; i != info.args.size(); ++i )
+	{
+		if ( info.args[ i ].kind == Indirect )
+		{
+			auto idx = info.arg_offset() + i;
+			target->addParamAttr( idx, Attribute::ByVal );
+			target->addParamAttr( idx, Attribute::getWithAlignment( TheContext, info.args[ i ].align ) );
+		}
+	}
+}
+
+void apply_attributes( Function *fn, const FunctionInfo &info )
+{
+	apply_attributes_impl( fn, info );
+}
+
+void apply_attributes( CallInst *call, const FunctionInfo &info )
+{
+	apply_attributes_impl( call, info );
+}
+
+AllocaInst *create_temporary( Type *type, const Twine &name )
+{
+	// keep temporaries in the entry block so that loops do not grow the stack
+	auto &entry = Builder.GetInsertBlock()->getParent()->getEntryBlock();
+	IRBuilder<> builder( &entry, entry.begin() );
+	return builder.CreateAlloca( type, nullptr, name );
+}
+
+void copy_aggregate( Value *dst, Value *src, Type *type, bool is_volatile )
+{
+	auto align = TheDataLayout->getABITypeAlignment( type );
+	Builder.CreateMemCpy( dst, align, src, align,
+						  TheDataLayout->getTypeAllocSize( type ), is_volatile );
+}
+
+Value *forward_aggregate( Value *val )
+{
+	auto load = dyn_cast<LoadInst>( val );
+	if ( !load || !load->getType()->isAggregateType() || !load->use_empty() ||
+		 load->getParent() != Builder.GetInsertBlock() )
+	{
+		return nullptr;
+	}
+	// the source must not be clobbered after it was loaded
+	for ( auto it = std::next( load->getIterator() ); it != load->getParent()->end(); ++it )
+	{
+		if ( it->mayWriteToMemory() ) return nullptr;
+	}
+	auto ptr = load->getPointerOperand();
+	load->eraseFromParent();
+	return ptr;
+}
+
+Value *materialize_aggregate( Value *val )
+{
+	if ( auto ptr = forward_aggregate( val ) ) return ptr;
+	auto tmp = create_temporary( val->getType() );
+	Builder.CreateStore( val, tmp );
+	return tmp;
+}
+
+void store_aggregate( Value *val, Value *ptr, bool is_volatile )
+{
+	auto type = val->getType();
+	if ( auto src = forward_aggregate( val ) )
+	{
+		copy_aggregate( ptr, src, type, is_volatile );
+	}
+	else
+	{
+		Builder.CreateStore( val, ptr, is_volatile );
+	}
+}
+
+// memory that holds both the aggregate and its coerced form
+static Value *create_coerce_slot( Type *type, Type *coerce_type, const Twine &name )
+{
+	if ( TheDataLayout->getTypeAllocSize( coerce_type ) > TheDataLayout->getTypeAllocSize( type ) )
+	{
+		return Builder.CreateBitCast( create_temporary( coerce_type, name ),
+									  PointerType::getUnqual( type ) );
+	}
+	return create_temporary( type, name );
+}
+
+static Value *load_coerced( Value *ptr, Type *type, Type *coerce_type )
+{
+	auto align = TheDataLayout->getABITypeAlignment( type );
+	if ( TheDataLayout->getTypeAllocSize( coerce_type ) > TheDataLayout->getTypeAllocSize( type ) )
+	{
+		auto tmp = create_coerce_slot( type, coerce_type, "coerce" );
+		copy_aggregate( tmp, ptr, type );
+		ptr = tmp;
+	}
+	return Builder.CreateAlignedLoad(
+	  Builder.CreateBitCast( ptr, PointerType::getUnqual( coerce_type ) ), align );
+}
+
+static void store_coerced( Value *val, Value *slot, Type *type )
+{
+	Builder.CreateAlignedStore(
+	  val,
+	  Builder.CreateBitCast( slot, PointerType::getUnqual( val->getType() ) ),
+	  TheDataLayout->getABITypeAlignment( type ) );
+}
+
+Value *lower_argument( const ArgInfo &info, Value *val )
+{
+	switch ( info.kind )
+	{
+	case Direct: return val;
+	case Coerce:
+	{
+		auto type = val->getType();
+		return load_coerced( materialize_aggregate( val ), type, info.coerce_type );
+	}
+	case Indirect: return materialize_aggregate( val );
+	}
+	INTERNAL_ERROR();
+}
+
+Value *lower_parameter( const ArgInfo &info, Argument *arg, Type *type, const Twine &name )
+{
+	switch ( info.kind )
+	{
+	case Direct:
+	{
+		auto alloc = Builder.CreateAlloca( type, 0, name );
+		Builder.CreateStore( arg, alloc );
+		return alloc;
+	}
+	case Coerce:
+	{
+		auto slot = create_coerce_slot( type, info.coerce_type, name );
+		arg->setName( name.concat( ".coerce" ) );
+		store_coerced( arg, slot, type );
+		return slot;
+	}
+	case Indirect:
+	{
+		arg->setName( name );
+		return arg;
+	}
+	}
+	INTERNAL_ERROR();
+}
+
+Value *lower_result( const ArgInfo &info, Value *res, Value *sret, Type *type )
+{
+	switch ( info.kind )
+	{
+	case Direct: return res;
+	case Coerce:
+	{
+		auto slot = create_coerce_slot( type, info.coerce_type, "agg.tmp" );
+		store_coerced( res, slot, type );
+		return slot;
+	}
+	case Indirect: return sret;
+	}
+	INTERNAL_ERROR();
+}
+
+void emit_return( const FunctionInfo &info, Value *val )
+{
+	switch ( info.ret.kind )
+	{
+	case Direct:
+	{
+		Builder.CreateRet( val );
+		break;
+	}
+	case Coerce:
+	{
+		auto type = val->getType();
+		Builder.CreateRet( load_coerced( materialize_aggregate( val ), type, info.ret.coerce_type ) );
+		break;
+	}
+	case Indirect:
+	{
+		auto sret = Builder.GetInsertBlock()->getParent()->arg_begin();
+		store_aggregate( val, sret );
+		Builder.CreateRet( nullptr );
+		break;
+	}
+	}
+}
+
+}  // namespace abi
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "predef.h"
+#include "type.h"
+
+// lowering of by-value aggregates across calls, following the
+// x86-64 System V calling convention. Other targets pass them in memory.
+namespace abi
+{
+enum ArgKind
+{
+	Direct,	   // passed as is
+	Coerce,	   // passed in registers, reinterpreted as `coerce_type`
+	Indirect   // passed in memory, `byval` for arguments and `sret` for results
+};
+
+struct ArgInfo
+{
+	ArgKind kind = Direct;
+	Type *coerce_type = nullptr;
+	unsigned align = 0;
+};
+
+struct FunctionInfo
+{
+	llvm::FunctionType *type = nullptr;
+	ArgInfo ret;
+	std::vector<ArgInfo> args;
+
+	unsigned arg_offset() const
+	{
+		return ret.kind == Indirect ? 1 : 0;
+	}
+};
+
+FunctionInfo classify_function( const mty::Qualified *ret, const std::vector<QualifiedDecl> &args, bool is_va_args );
+
+void apply_attributes( Function *fn, const FunctionInfo &info );
+void apply_attributes( CallInst *call, const FunctionInfo &info );
+
+AllocaInst *create_temporary( Type *type, const Twine &name = "agg.tmp" );
+void copy_aggregate( Value *dst, Value *src, Type *type, bool is_volatile = false );
+// returns the address of a just loaded aggregate when the load can be
+// replaced by a copy from its source, the load is erased in this case.
+Value *forward_aggregate( Value *val );
+// returns an address holding the aggregate `val`.
+Value *materialize_aggregate( Value *val );
+// stores the aggregate `val`, as a single copy from its source if possible.
+void store_aggregate( Value *val, Value *ptr, bool is_volatile = false );
+
+Value *lower_argument( const ArgInfo &info, Value *val );
+Value *lower_parameter( const ArgInfo &info, Argument *arg, Type *type, const Twine &name );
+Value *lower_result( const ArgInfo &info, Value *res, Value *sret, Type *type );
+void emit_return( const FunctionInfo &info, Value *val );
+
+}  // namespace abi
@@ -0,0 +1,274 @@
+#include "def.h"
+#include "attribute.h"
+
+static std::string trim( const std::string &str )
+{
+	auto begin = str.find_first_not_of( " \t\n" );
+	if ( begin == std::string::npos ) return "";
+	auto end = str.find_last_not_of( " \t\n" );
+	return str.substr( begin, end - begin + 1 );
+}
+
+// `__attribute__ (( a, b (x, y) ))` => [ "a", "b (x, y)" ]
+static std::vector<std::string> split_attributes( const std::string &spec )
+{
+	std::vector<std::string> items;
+	auto begin = spec.find( '(' );
+	auto end = spec.rfind( ')' );
+	if ( begin == std::string::npos || end == std::string::npos || end <= begin ) return items;
+	auto body = trim( spec.substr( begin + 1, end - begin - 1 ) );
+	if ( body.size() < 2 || body.front() != '(' || body.back() != ')' ) return items;
+	body = body.substr( 1, body.size() - 2 );
+
+	int depth = 0;
+	std::string item;
+	for ( auto c : body )
+	{
+		if ( c == '(' ) depth++;
+		if ( c == ')' ) depth--;
+		if ( c == ',' && depth == 0 )
+		{
+			items.emplace_back( trim( item ) );
+			item.clear();
+		}
+		else
+		{
+			item += c;
+		}
+	}
+	items.emplace_back( trim( item ) );
+	return items;
+}
+
+void GnuAttributes::add_attribute( unsigned attr, const std::string &name, Json::Value const &ast )
+{
+	static const std::pair<unsigned, unsigned> conflicts[] = {
+		{ GA_HOT, GA_COLD },
+		{ GA_ALWAYS_INLINE, GA_NOINLINE }
+	};
+	for ( auto &conflict : conflicts )
+	{
+		if ( ( attr == conflict.first && ( this->attrs & conflict.second ) ) ||
+			 ( attr == conflict.second && ( this->attrs & conflict.first ) ) )
+		{
+			infoList->add_msg(
+			  MSG_TYPE_WARNING,
+			  fmt( "ignoring attribute `", name, "` because it conflicts with a previous attribute" ),
+			  ast );
+			return;
+		}
+	}
+	this->attrs |= attr;
+}
+
+GnuAttributes &GnuAttributes::add( const std::string &spec, Json::Value const &ast )
+{
+	static LookupTable<unsigned> attr_map = {
+		{ "hot", GA_HOT },
+		{ "cold", GA_COLD },
+		{ "always_inline", GA_ALWAYS_INLINE },
+		{ "noinline", GA_NOINLINE },
+		{ "pure", GA_PURE },
+		{ "const", GA_CONST },
+		{ "noreturn", GA_NORETURN },
+	};
+
+	for ( auto &item : split_attributes( spec ) )
+	{
+		if ( item.empty() ) continue;
+
+		auto paren = item.find( '(' );
+		auto name = trim( item.substr( 0, paren ) );
+		std::string args;
+		if ( paren != std::string::npos )
+		{
+			args = trim( item.substr( paren + 1, item.rfind( ')' ) - paren - 1 ) );
+		}
+		// `__name__` is the same as `name`
+		if ( name.size() > 4 && name.compare( 0, 2, "__" ) == 0 &&
+			 name.compare( name.size() - 2, 2, "__" ) == 0 )
+		{
+			name = name.substr( 2, name.size() - 4 );
+		}
+
+		if ( attr_map.find( name.c_str() ) != attr_map.end() )
+		{
+			add_attribute( attr_map[ name.c_str() ], name, ast );
+		}
+		else if ( name == "aligned" )
+		{
+			unsigned long align = 16;  // the largest alignment ever used on the target
+			if ( !args.empty() )
+			{
+				char *end;
+				align = std::strtoul( args.c_str(), &end, 0 );
+				if ( *end != 0 || align == 0 || ( align & ( align - 1 ) ) != 0 )
+				{
+					infoList->add_msg(
+					  MSG_TYPE_ERROR,
+					  fmt( "requested alignment `", args, "` is not a power of 2 integer constant" ),
+					  ast );
+					HALT();
+				}
+			}
+			this->align = std::max<unsigned>( this->align, align );
+		}
+		else if ( name == "vector_size" )
+		{
+			char *end;
+			auto size = std::strtoul( args.c_str(), &end, 0 );
+			if ( args.empty() || *end != 0 || size == 0 )
+			{
+				infoList->add_msg(
+				  MSG_TYPE_ERROR,
+				  fmt( "vector size `", args, "` is not a positive integer constant" ),
+				  ast );
+				HALT();
+			}
+			this->vector_size = size;
+		}
+		else
+		{
+			infoList->add_msg( MSG_TYPE_WARNING, fmt( "unknown attribute `", name, "` ignored" ), ast );
+		}
+	}
+
+	return *this;
+}
+
+GnuAttributes &GnuAttributes::merge( const GnuAttributes &other, Json::Value const &ast )
+{
+	static const std::pair<unsigned, const char *> names[] = {
+		{ GA_HOT, "hot" },
+		{ GA_COLD, "cold" },
+		{ GA_ALWAYS_INLINE, "always_inline" },
+		{ GA_NOINLINE, "noinline" },
+		{ GA_PURE, "pure" },
+		{ GA_CONST, "const" },
+		{ GA_NORETURN, "noreturn" }
+	};
+	for ( auto &attr : names )
+	{
+		if ( other.has_attribute( attr.first ) ) add_attribute( attr.first, attr.second, ast );
+	}
+	this->align = std::max( this->align, other.align );
+	if ( other.vector_size ) this->vector_size = other.vector_size;
+	return *this;
+}
+
+void GnuAttributes::apply( QualifiedTypeBuilder &builder, Json::Value const &ast ) const
+{
+	if ( !vector_size ) return;
+
+	auto elem = builder.get_type();
+	unsigned bits = 0;
+	if ( auto int_ty = elem->as<mty::Integer>() )
+	{
+		bits = int_ty->bits;
+	}
+	else if ( auto fp_ty = elem->as<mty::FloatingPoint>() )
+	{
+		bits = fp_ty->bits;
+	}
+	if ( bits < 8 )
+	{
+		infoList->add_msg(
+		  MSG_TYPE_ERROR,
+		  fmt( "invalid vector element type `", QualifiedTypeBuilder( builder ).build(), "`" ),
+		  ast );
+		HALT();
+	}
+	if ( vector_size % ( bits / 8 ) != 0 )
+	{
+		infoList->add_msg(
+		  MSG_TYPE_ERROR,
+		  fmt( "vector size `", vector_size, "` is not a multiple of the element size" ),
+		  ast );
+		HALT();
+	}
+	auto len = vector_size / ( bits / 8 );
+	if ( ( len & ( len - 1 ) ) != 0 )
+	{
+		infoList->add_msg(
+		  MSG_TYPE_ERROR,
+		  fmt( "number of vector elements `", len, "` is not a power of 2" ),
+		  ast );
+		HALT();
+	}
+	builder.add_level( std::make_shared<mty::Vector>( elem->type, len, elem->is_const, elem->is_volatile ) );
+}
+
+void GnuAttributes::apply( Function *fn ) const
+{
+	// llvm has no `hot` function attribute, place the function in .text.hot instead
+	if ( has_attribute( GA_HOT ) && !fn->hasFnAttribute( Attribute::Cold ) )
+	{
+		fn->setSectionPrefix( ".hot" );
+	}
+	if ( has_attribute( GA_COLD ) )
+	{
+		fn->addFnAttr( Attribute::Cold );
+		fn->setSectionPrefix( ".unlikely" );
+	}
+	if ( has_attribute( GA_ALWAYS_INLINE ) && !fn->hasFnAttribute( Attribute::NoInline ) )
+	{
+		fn->addFnAttr( Attribute::AlwaysInline );
+	}
+	if ( has_attribute( GA_NOINLINE ) )
+	{
+		fn->removeFnAttr( Attribute::AlwaysInline );
+		fn->addFnAttr( Attribute::NoInline );
+	}
+	// the abi lowering already marked the aggregates passed in memory: an
+	// `sret` result is written and a `byval` argument is read by the callee,
+	// so such a function only gets away with not touching its arguments' memory
+	bool has_sret = false, has_byval = false;
+	for ( auto &arg : fn->args() )
+	{
+		has_sret = has_sret || arg.hasStructRetAttr();
+		has_byval = has_byval || arg.hasByValAttr();
+	}
+	if ( has_attribute( GA_CONST ) )
+	{
+		fn->removeFnAttr( Attribute::ReadOnly );
+		if ( has_sret || has_byval )
+		{
+			fn->addFnAttr( Attribute::ArgMemOnly );
+			if ( !has_sret ) fn->addFnAttr( Attribute::ReadOnly );
+		}
+		else
+		{
+			fn->addFnAttr( Attribute::ReadNone );
+		}
+		fn->addFnAttr( Attribute::NoUnwind );
+	}
+	else if ( has_attribute( GA_PURE ) && !fn->hasFnAttribute( Attribute::ReadNone ) )
+	{
+		if ( !has_sret ) fn->addFnAttr( Attribute::ReadOnly );
+		fn->addFnAttr( Attribute::NoUnwind );
+	}
+	if ( has_attribute( GA_NORETURN ) )
+	{
+		fn->addFnAttr( Attribute::NoReturn );
+	}
+	if ( align > fn->getAlignment() )
+	{
+		fn->setAlignment( align );
+	}
+}
+
+void GnuAttributes::apply( GlobalVariable *var ) const
+{
+	if ( align > var->getAlignment() )
+	{
+		var->setAlignment( align );
+	}
+}
+
+void GnuAttributes::apply( AllocaInst *alloc ) const
+{
+	if ( align > alloc->getAlignment() )
+	{
+		alloc->setAlignment( align );
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "predef.h"
+
+#define GA_HOT 0x1
+#define GA_COLD 0x2
+#define GA_ALWAYS_INLINE 0x4
+#define GA_NOINLINE 0x8
+#define GA_PURE 0x10
+#define GA_CONST 0x20
+#define GA_NORETURN 0x40
+
+#define FUNCTION_ATTRIBUTE 0x7f
+
+class QualifiedTypeBuilder;
+
+// gnu `__attribute__(( ... ))` attached to a declaration
+class GnuAttributes
+{
+private:
+	unsigned attrs = 0;
+	unsigned align = 0;
+	unsigned vector_size = 0;
+
+	void add_attribute( unsigned attr, const std::string &name, Json::Value const &ast );
+
+public:
+	GnuAttributes &add( const std::string &spec, Json::Value const &ast );
+	GnuAttributes &merge( const GnuAttributes &other, Json::Value const &ast );
+
+	bool has_attribute( unsigned attr ) const
+	{
+		return ( this->attrs & attr ) != 0;
+	}
+	unsigned get_align() const
+	{
+		return this->align;
+	}
+
+	// `vector_size` turns the type being declared into a vector type
+	void apply( QualifiedTypeBuilder &builder, Json::Value const &ast ) const;
+	void apply( Function *fn ) const;
+	void apply( GlobalVariable *var ) const;
+	void apply( AllocaInst *alloc ) const;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "type.h"
+#include "../target.h"
 
 #define SC_TYPEDEF 0x10
 #define SC_EXTERN 0x20
@@ -35,6 +36,7 @@ class DeclarationSpecifiers
 private:
 	Option<QualifiedType> type;
 	unsigned attrs = 0;
+	GnuAttributes gnu_attrs;
 
 private:
 	int get_attr_from( const char *name ) const
@@ -149,6 +151,12 @@ public:
 		return *this;
 	}
 
+	DeclarationSpecifiers &add_gnu_attribute( const std::string &spec, Json::Value const &ast )
+	{
+		this->gnu_attrs.add( spec, ast );
+		return *this;
+	}
+
 	bool has_attribute( const char *name ) const
 	{
 		auto attr = get_attr_from( name );
@@ -159,12 +167,25 @@ public:
 		return ( this->attrs & attr ) != 0;
 	}
 
+	GnuAttributes const &get_gnu_attributes() const
+	{
+		return this->gnu_attrs;
+	}
+
 	Option<QualifiedType> const &get_type() const
 	{
 		return this->type;
 	}
 
 	QualifiedTypeBuilder into_type_builder( Json::Value const &ast ) const
+	{
+		auto builder = into_base_type_builder( ast );
+		gnu_attrs.apply( builder, ast );
+		return builder;
+	}
+
+private:
+	QualifiedTypeBuilder into_base_type_builder( Json::Value const &ast ) const
 	{
 		bool is_const = ( this->attrs & TQ_CONST ) != 0;
 		bool is_volatile = ( this->attrs & TQ_VOLATILE ) != 0;
@@ -220,7 +241,7 @@ public:
 				if ( ( attrs & TYPE_MODIFIER ) != 0 )
 				{  // only modifier
 					if ( ( attrs & TM_SHORT ) != 0 ) num_bits = num_bits >> 1;
-					if ( ( attrs & TM_LONG ) != 0 ) num_bits = num_bits << 1;
+					if ( ( attrs & TM_LONG ) != 0 ) num_bits = base_type == TS_INT ? TheTargetInfo->long_width() : num_bits << 1;
 					if ( ( attrs & TM_LONG_LONG ) != 0 ) num_bits = num_bits << 1;
 
 					if ( ( attrs & TM_SIGNED ) != 0 ) is_signed = true;
@@ -249,6 +270,7 @@ public:
 		}
 	}
 
+public:
 	friend std::ostream &operator<<( std::ostream &os, const DeclarationSpecifiers &declspec )
 	{
 		os << "{ ";
@@ -12,5 +12,6 @@
 #include "structType.h"
 #include "unionType.h"
 #include "enumType.h"
+#include "vectorType.h"
 
 #include "declarationSpecifier.h"
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "predef.h"
+#include "../target.h"
 
 namespace mty
 {
@@ -55,7 +56,7 @@ private:
 		case 16: return Type::getHalfTy( TheContext );
 		case 32: return Type::getFloatTy( TheContext );
 		case 64: return Type::getDoubleTy( TheContext );
-		case 128: return Type::getFP128Ty( TheContext );
+		case 128: return TheTargetInfo->long_double_type();  // `long double`, whatever the target makes of it
 		default:
 		{
 			infoList->add_msg( MSG_TYPE_ERROR, "invalid floating point type: f", bits );
@@ -2,6 +2,7 @@
 
 #include "predef.h"
 #include "type.h"
+#include "abi.h"
 
 namespace mty
 {
@@ -12,14 +13,43 @@ struct Function : Address
 	std::vector<QualifiedDecl> args;
 	bool is_va_args = false;
 
-	Function( Type *result_type, const std::vector<QualifiedDecl> &args, bool is_va_args ) :
-	  Address( FunctionType::get( result_type, map_type( args ), is_va_args ) ),
+	Function( const Qualified *result, const std::vector<QualifiedDecl> &args, bool is_va_args ) :
+	  Address( nullptr ),
 	  args( args ),
-	  is_va_args( is_va_args )
+	  is_va_args( is_va_args ),
+	  result( result->clone() ),
+	  abi_cache( abi::classify_function( result, args, is_va_args ) ),
+	  abi_settled( has_complete_aggregates() )
 	{
+		type = abi_cache.type;
 		type_name = self_type;
 	}
 
+	// `struct S f( struct S );` may come before `struct S` is defined, so the
+	// abi is classified again until its aggregates are complete. `type` stays
+	// the one of the declaration, calls and definitions use this one
+	const abi::FunctionInfo &abi_info() const
+	{
+		if ( !abi_settled )
+		{
+			abi_cache = abi::classify_function( result.get(), args, is_va_args );
+			abi_settled = has_complete_aggregates();
+		}
+		return abi_cache;
+	}
+
+	// the abi of one call, the arguments after `...` take registers and are
+	// lowered like the named ones. The callee keeps its declared type
+	abi::FunctionInfo call_abi_info( const std::vector<QualifiedDecl> &va_args ) const
+	{
+		if ( va_args.empty() ) return abi_info();
+		auto all_args = args;
+		all_args.insert( all_args.end(), va_args.begin(), va_args.end() );
+		auto info = abi::classify_function( result.get(), all_args, is_va_args );
+		info.type = abi_info().type;
+		return info;
+	}
+
 	bool is_valid_element_type() const override
 	{
 		return false;
@@ -65,6 +95,24 @@ struct Function : Address
 	// 	return Option<const std::pair<std::shared_ptr<QualifiedType>, Value *> *>();
 	// }
 
+private:
+	std::shared_ptr<Qualified> result;
+	mutable abi::FunctionInfo abi_cache;
+	mutable bool abi_settled;
+
+	bool has_complete_aggregates() const
+	{
+		auto is_complete = []( const Qualified *type ) {
+			return !type->is<Structural>() || type->is_complete();
+		};
+		if ( !is_complete( result.get() ) ) return false;
+		for ( auto &arg : args )
+		{
+			if ( !is_complete( arg.type.get() ) ) return false;
+		}
+		return true;
+	}
+
 protected:
 	// static std::map<std::string, std::pair<std::shared_ptr<QualifiedType>, Value *>> &decls()
 	// {
@@ -97,14 +145,6 @@ public:
 		  ast );
 		HALT();
 	}
-
-private:
-	static std::vector<Type *> map_type( const std::vector<QualifiedDecl> &args )
-	{
-		std::vector<Type *> new_args;
-		for ( auto arg : args ) new_args.push_back( arg.type->type );
-		return new_args;
-	}
 };
 
 }  // namespace mty
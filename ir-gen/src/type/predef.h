@@ -20,7 +20,8 @@ enum TypeName
 	FunctionType,
 	ArrayType,
 	StructType,
-	EnumType
+	EnumType,
+	VectorType
 };
 
 struct Qualified
@@ -30,7 +30,7 @@ TypeView const &TypeView::getCharTy( bool is_signed )
 	static auto u_ty = std::make_shared<QualifiedType>( std::make_shared<mty::Integer>( 8, false ) );
 
 	static auto s_v = TypeView( s_ty );
-	static auto u_v = TypeView( s_ty );
+	static auto u_v = TypeView( u_ty );
 
 	return is_signed ? s_v : u_v;
 }
@@ -40,7 +40,7 @@ TypeView const &TypeView::getShortTy( bool is_signed )
 	static auto u_ty = std::make_shared<QualifiedType>( std::make_shared<mty::Integer>( 16, false ) );
 
 	static auto s_v = TypeView( s_ty );
-	static auto u_v = TypeView( s_ty );
+	static auto u_v = TypeView( u_ty );
 
 	return is_signed ? s_v : u_v;
 }
@@ -50,19 +50,13 @@ TypeView const &TypeView::getIntTy( bool is_signed )
 	static auto u_ty = std::make_shared<QualifiedType>( std::make_shared<mty::Integer>( 32, false ) );
 
 	static auto s_v = TypeView( s_ty );
-	static auto u_v = TypeView( s_ty );
+	static auto u_v = TypeView( u_ty );
 
 	return is_signed ? s_v : u_v;
 }
 TypeView const &TypeView::getLongTy( bool is_signed )
 {
-	static auto s_ty = std::make_shared<QualifiedType>( std::make_shared<mty::Integer>( 64, true ) );
-	static auto u_ty = std::make_shared<QualifiedType>( std::make_shared<mty::Integer>( 64, false ) );
-
-	static auto s_v = TypeView( s_ty );
-	static auto u_v = TypeView( s_ty );
-
-	return is_signed ? s_v : u_v;
+	return TheTargetInfo->long_type( is_signed );
 }
 TypeView const &TypeView::getLongLongTy( bool is_signed )
 {
@@ -70,10 +64,14 @@ TypeView const &TypeView::getLongLongTy( bool is_signed )
 	static auto u_ty = std::make_shared<QualifiedType>( std::make_shared<mty::Integer>( 64, false ) );
 
 	static auto s_v = TypeView( s_ty );
-	static auto u_v = TypeView( s_ty );
+	static auto u_v = TypeView( u_ty );
 
 	return is_signed ? s_v : u_v;
 }
+TypeView const &TypeView::getPtrDiffTy( bool is_signed )
+{
+	return TheTargetInfo->ptrdiff_type( is_signed );
+}
 TypeView const &TypeView::getFloatTy()
 {
 	static auto s_ty = std::make_shared<QualifiedType>( std::make_shared<mty::FloatingPoint>( 32 ) );
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "predef.h"
+#include "attribute.h"
 
 class QualifiedTypeBuilder;
 class TypeView;
@@ -243,6 +244,7 @@ public:
 	static TypeView const &getIntTy( bool is_signed );
 	static TypeView const &getLongTy( bool is_signed );
 	static TypeView const &getLongLongTy( bool is_signed );
+	static TypeView const &getPtrDiffTy( bool is_signed );	// also size_t
 	static TypeView const &getFloatTy();
 	static TypeView const &getDoubleTy();
 	static TypeView const &getLongDoubleTy();
@@ -257,6 +259,7 @@ struct QualifiedDecl
 {
 	QualifiedType type;
 	Option<std::string> name;
+	GnuAttributes attrs;
 
 public:
 	QualifiedDecl( const QualifiedType &type, const std::string &name ) :
@@ -2,8 +2,7 @@
 
 #include "predef.h"
 #include "type.h"
-
-extern std::unique_ptr<DataLayout> TheDataLayout;
+#include "../target.h"
 
 namespace mty
 {
@@ -72,6 +71,11 @@ struct Union : Structural
 		}
 	}
 
+	bool is_complete() const override
+	{
+		return !static_cast<llvm::StructType *>( this->type )->isOpaque();
+	}
+
 	void print( std::ostream &os, const std::vector<std::shared_ptr<Qualified>> &st, int id ) const override
 	{
 		if ( is_const ) os << "const ";
@@ -112,28 +116,12 @@ public:
 private:
 	static std::vector<Type *> map_comp( const std::vector<QualifiedDecl> &comps )
 	{
-		std::vector<Type *> new_args;
-		unsigned max_bytes_size = 0;
-		Type *long_ty = nullptr;
-
-		for ( auto comp : comps )
-		{
-			if ( auto bytes_size = TheDataLayout->getTypeAllocSize( comp.type->type ) )
-			{
-				if ( bytes_size > max_bytes_size )
-				{
-					max_bytes_size = bytes_size;
-					long_ty = comp.type->type;
-				}
-			}
-		}
-
-		if ( long_ty )
+		std::vector<Type *> members;
+		for ( auto &comp : comps )
 		{
-			new_args.emplace_back( long_ty );
+			members.emplace_back( comp.type->type );
 		}
-
-		return new_args;
+		return TheTargetInfo->union_body( members );
 	}
 };
 
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "predef.h"
+
+namespace mty
+{
+// gnu `__attribute__((vector_size(N)))` applied to an integer or floating point type
+struct Vector : Qualified
+{
+	static constexpr auto self_type = TypeName::VectorType;
+
+	std::size_t len;
+
+	Vector( Type *element_type, std::size_t len, bool is_const = false, bool is_volatile = false ) :
+	  Qualified( llvm::VectorType::get( element_type, len ), is_const, is_volatile ),
+	  len( len )
+	{
+		type_name = self_type;
+	}
+
+	std::size_t bytes() const
+	{
+		return len * type->getScalarSizeInBits() / 8;
+	}
+
+	void print( std::ostream &os, const std::vector<std::shared_ptr<Qualified>> &st, int id ) const override
+	{
+		os << "__attribute__((vector_size(" << bytes() << ")))";
+		if ( is_const ) os << " const";
+		if ( is_volatile ) os << " volatile";
+		if ( st.size() != ++id )
+		{
+			os << " ";
+			st[ id ]->print( os, st, id );
+		}
+	}
+
+	std::shared_ptr<Qualified> clone() const override
+	{
+		return std::make_shared<Vector>( *this );
+	}
+
+protected:
+	bool impl_is_same_without_cv( const Qualified &other ) const override
+	{
+		auto &ref = static_cast<const Vector &>( other );
+		return ref.len == len;
+	}
+};
+
+}  // namespace mty
@@ -0,0 +1,197 @@
+#include "value.h"
+#include "../global.h"
+
+#include "llvm/Analysis/ValueTracking.h"
+
+enum LibFunc
+{
+	LF_MEMCPY,
+	LF_MEMMOVE,
+	LF_MEMSET,
+	LF_STRLEN
+};
+
+static bool match_signature( Function *fn, LibFunc func )
+{
+	auto fn_ty = fn->getFunctionType();
+	auto i8_ptr = Type::getInt8PtrTy( TheContext );
+
+	if ( fn_ty->isVarArg() ) return false;
+
+	switch ( func )
+	{
+	case LF_MEMCPY:
+	case LF_MEMMOVE:
+		return fn_ty->getNumParams() == 3 &&
+			   fn_ty->getReturnType() == i8_ptr &&
+			   fn_ty->getParamType( 0 ) == i8_ptr &&
+			   fn_ty->getParamType( 1 ) == i8_ptr &&
+			   fn_ty->getParamType( 2 )->isIntegerTy();
+	case LF_MEMSET:
+		return fn_ty->getNumParams() == 3 &&
+			   fn_ty->getReturnType() == i8_ptr &&
+			   fn_ty->getParamType( 0 ) == i8_ptr &&
+			   fn_ty->getParamType( 1 )->isIntegerTy() &&
+			   fn_ty->getParamType( 2 )->isIntegerTy();
+	case LF_STRLEN:
+		return fn_ty->getNumParams() == 1 &&
+			   fn_ty->getReturnType()->isIntegerTy() &&
+			   fn_ty->getParamType( 0 ) == i8_ptr;
+	}
+	return false;
+}
+
+// alignment of the object an argument of type `view` points to.
+static unsigned get_pointee_align( TypeView view )
+{
+	if ( view->is<mty::Pointer>() || view->is<mty::Array>() )
+	{
+		view.next();
+		if ( !view->is<mty::Void>() && !view->is<mty::Function>() && view->is_complete() )
+		{
+			return TheDataLayout->getABITypeAlignment( view->type );
+		}
+	}
+	return 1;
+}
+
+struct MathFunc
+{
+	Intrinsic::ID id;
+	unsigned arity;
+	bool sets_errno;  // only an intrinsic under -fno-math-errno
+};
+
+// `name` is a libm function of the same floating point type throughout,
+// the `f` and `l` variants share the entry of the double one
+static const MathFunc *find_math_func( Function *fn )
+{
+	static std::map<std::string, MathFunc> mathcalls = {
+		{ "fabs", { Intrinsic::fabs, 1, false } },
+		{ "floor", { Intrinsic::floor, 1, false } },
+		{ "ceil", { Intrinsic::ceil, 1, false } },
+		{ "trunc", { Intrinsic::trunc, 1, false } },
+		{ "round", { Intrinsic::round, 1, false } },
+		{ "rint", { Intrinsic::rint, 1, false } },
+		{ "nearbyint", { Intrinsic::nearbyint, 1, false } },
+		{ "copysign", { Intrinsic::copysign, 2, false } },
+		{ "fmin", { Intrinsic::minnum, 2, false } },
+		{ "fmax", { Intrinsic::maxnum, 2, false } },
+		{ "sqrt", { Intrinsic::sqrt, 1, true } },
+		{ "sin", { Intrinsic::sin, 1, true } },
+		{ "cos", { Intrinsic::cos, 1, true } },
+		{ "exp", { Intrinsic::exp, 1, true } },
+		{ "exp2", { Intrinsic::exp2, 1, true } },
+		{ "log", { Intrinsic::log, 1, true } },
+		{ "log2", { Intrinsic::log2, 1, true } },
+		{ "log10", { Intrinsic::log10, 1, true } },
+		{ "pow", { Intrinsic::pow, 2, true } },
+		{ "fma", { Intrinsic::fma, 3, true } },
+	};
+
+	auto fn_ty = fn->getFunctionType();
+	auto ret_ty = fn_ty->getReturnType();
+	if ( fn_ty->isVarArg() || !ret_ty->isFloatingPointTy() ) return nullptr;
+	for ( auto param : fn_ty->params() )
+	{
+		if ( param != ret_ty ) return nullptr;
+	}
+
+	auto name = fn->getName().str();
+	auto func = mathcalls.find( name );
+	if ( func == mathcalls.end() && ( name.back() == 'f' || name.back() == 'l' ) )
+	{
+		auto suffix_ty = name.back() == 'f' ? Type::getFloatTy( TheContext ) : TypeView::getLongDoubleTy()->type;
+		if ( ret_ty != suffix_ty ) return nullptr;
+		func = mathcalls.find( name.substr( 0, name.size() - 1 ) );
+	}
+	else if ( !ret_ty->isDoubleTy() )
+	{
+		return nullptr;
+	}
+	if ( func == mathcalls.end() || func->second.arity != fn_ty->getNumParams() ) return nullptr;
+	return &func->second;
+}
+
+static bool is_pointee_volatile( TypeView view )
+{
+	if ( view->is<mty::Pointer>() || view->is<mty::Array>() )
+	{
+		return view.next()->is_volatile;
+	}
+	return false;
+}
+
+Value *QualifiedValue::lower_libcall( Value *callee, const std::vector<TypeView> &args_type,
+									  const std::vector<Value *> &args_val )
+{
+	static LookupTable<LibFunc> libcalls = {
+		{ "memcpy", LF_MEMCPY },
+		{ "memmove", LF_MEMMOVE },
+		{ "memset", LF_MEMSET },
+		{ "strlen", LF_STRLEN }
+	};
+
+	if ( compileOptions.no_builtin ) return nullptr;
+
+	auto fn = dyn_cast<Function>( callee );
+	if ( !fn || !fn->hasExternalLinkage() ) return nullptr;
+
+	auto name = fn->getName().str();
+
+	if ( auto math = find_math_func( fn ) )
+	{
+		if ( math->sets_errno && compileOptions.math_errno ) return nullptr;
+		dbg( "lowering libm call `", name, "`" );
+		auto intrinsic = Intrinsic::getDeclaration( TheModule.get(), math->id, { fn->getReturnType() } );
+		return Builder.CreateCall( intrinsic, args_val );
+	}
+
+	auto func = libcalls.find( name.c_str() );
+	if ( func == libcalls.end() || !match_signature( fn, func->second ) ) return nullptr;
+
+	dbg( "lowering libcall `", name, "`" );
+
+	switch ( func->second )
+	{
+	case LF_MEMCPY:
+	{
+		Builder.CreateMemCpy(
+		  args_val[ 0 ], get_pointee_align( args_type[ 0 ] ),
+		  args_val[ 1 ], get_pointee_align( args_type[ 1 ] ),
+		  args_val[ 2 ],
+		  is_pointee_volatile( args_type[ 0 ] ) || is_pointee_volatile( args_type[ 1 ] ) );
+		return args_val[ 0 ];
+	}
+	case LF_MEMMOVE:
+	{
+		Builder.CreateMemMove(
+		  args_val[ 0 ], get_pointee_align( args_type[ 0 ] ),
+		  args_val[ 1 ], get_pointee_align( args_type[ 1 ] ),
+		  args_val[ 2 ],
+		  is_pointee_volatile( args_type[ 0 ] ) || is_pointee_volatile( args_type[ 1 ] ) );
+		return args_val[ 0 ];
+	}
+	case LF_MEMSET:
+	{
+		Builder.CreateMemSet(
+		  args_val[ 0 ],
+		  Builder.CreateIntCast( args_val[ 1 ], Builder.getInt8Ty(), false ),
+		  args_val[ 2 ],
+		  get_pointee_align( args_type[ 0 ] ),
+		  is_pointee_volatile( args_type[ 0 ] ) );
+		return args_val[ 0 ];
+	}
+	case LF_STRLEN:
+	{
+		StringRef str;
+		if ( getConstantStringInfo( args_val[ 0 ], str ) )
+		{
+			return ConstantInt::get( fn->getReturnType(), str.size() );
+		}
+		return nullptr;
+	}
+	}
+
+	return nullptr;
+}
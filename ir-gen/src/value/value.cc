@@ -1,4 +1,5 @@
 #include "value.h"
+#include "../global.h"
 
 bool QualifiedValue::deref_into_ptr_unwrap( TypeView &view, Value *&val )
 {
@@ -117,6 +118,12 @@ void QualifiedValue::cast_binary_expr( QualifiedValue &self, QualifiedValue &oth
 		INTERNAL_ERROR();
 	}
 
+	if ( self.type->is<mty::Vector>() || other.type->is<mty::Vector>() )
+	{
+		cast_binary_vector( self, other, node, allow_float, lhsbb, rhsbb );
+		return;
+	}
+
 	auto lhs = allow_float ? self.type->as<mty::Arithmetic>() : self.type->as<mty::Integer>();
 	auto rhs = allow_float ? other.type->as<mty::Arithmetic>() : other.type->as<mty::Integer>();
 
@@ -208,6 +215,51 @@ void QualifiedValue::cast_binary_expr( QualifiedValue &self, QualifiedValue &oth
 	}
 }
 
+void QualifiedValue::cast_binary_vector( QualifiedValue &self, QualifiedValue &other, Json::Value &node, bool allow_float,
+										 BasicBlock *lhsbb, BasicBlock *rhsbb )
+{
+	auto invalid_operands = [&] {
+		infoList->add_msg(
+		  MSG_TYPE_ERROR,
+		  fmt( "invalid operands to binary expression (`", self.type, "` and `", other.type, "`)" ),
+		  node );
+		HALT();
+	};
+	// a scalar operand is converted to the element type and splatted
+	auto splat = [&]( QualifiedValue &scalar, const TypeView &vec_ty, BasicBlock *bb ) {
+		if ( !scalar.type->is<mty::Arithmetic>() ) invalid_operands();
+		auto elem_ty = vec_ty;
+		elem_ty.next();
+		if ( bb ) Builder.SetInsertPoint( bb );
+		scalar.cast( elem_ty, node, false );
+		scalar.val = Builder.CreateVectorSplat( vec_ty->as<mty::Vector>()->len, scalar.val );
+		scalar.type = vec_ty;
+	};
+
+	if ( self.type->is<mty::Vector>() && other.type->is<mty::Vector>() )
+	{
+		if ( !self.type.is_same_discard_qualifiers( other.type ) )
+		{
+			infoList->add_msg(
+			  MSG_TYPE_ERROR,
+			  fmt( "cannot convert between vector values of different types (`", self.type, "` and `", other.type, "`)" ),
+			  node );
+			HALT();
+		}
+	}
+	else if ( self.type->is<mty::Vector>() )
+	{
+		splat( other, self.type, rhsbb );
+	}
+	else
+	{
+		splat( self, other.type, lhsbb );
+	}
+
+	auto elem_ty = self.type;
+	if ( !allow_float && !elem_ty.next()->is<mty::Integer>() ) invalid_operands();
+}
+
 void QualifiedValue::cast_ternary_expr( QualifiedValue &self, QualifiedValue &other, Json::Value &node,
 										BasicBlock *lhsbb, BasicBlock *rhsbb )
 {
@@ -254,6 +306,11 @@ QualifiedValue &QualifiedValue::cast( const TypeView &dst, Json::Value &node, bo
 
 	this->ensure_is_ptr_if_deref();
 
+	if ( ( dst->is<mty::Vector>() || this->type->is<mty::Vector>() ) && !dst->is<mty::Void>() )
+	{
+		return cast_vector( dst, node, warn );
+	}
+
 	if ( dst->is<mty::Arithmetic>() )
 	{
 		if ( auto this_arith_ty = this->type->as<mty::Arithmetic>() )
@@ -341,7 +398,7 @@ QualifiedValue &QualifiedValue::cast( const TypeView &dst, Json::Value &node, bo
 				auto &long_ty = TypeView::getLongTy( false )->type;
 				this->val = Builder.CreateICmpNE(
 				  Builder.CreatePtrToInt( this->val, long_ty ),
-				  Constant::getIntegerValue( long_ty, APInt( 64, 0 ) ) );
+				  Constant::getNullValue( long_ty ) );
 			}
 			else
 			{
@@ -482,3 +539,234 @@ QualifiedValue &QualifiedValue::cast( const TypeView &dst, Json::Value &node, bo
 
 	return *this;
 }
+
+QualifiedValue &QualifiedValue::call( std::vector<QualifiedValue> &args, Json::Value &ast )
+{
+	if ( is_lvalue )
+	{
+		INTERNAL_ERROR();
+	}
+
+	auto &children = ast[ "children" ];
+	while ( type->is<mty::Pointer>() )
+	{
+		deref( children[ 0 ] ).value( children[ 0 ] );
+	}
+
+	if ( auto fn = type->as<mty::Function>() )
+	{
+		if ( fn->is_va_args && args.size() < fn->args.size() ||
+			 !fn->is_va_args && args.size() != fn->args.size() )
+		{
+			infoList->add_msg(
+			  MSG_TYPE_ERROR,
+			  fmt( "too ", args.size() > fn->args.size() ? "many" : "few",
+				   " arguments to function call, exprected ",
+				   fn->is_va_args ? "at least " : "", fn->args.size(),
+				   ", have ", args.size() ),
+			  ast );
+			HALT();
+		}
+		// the argument types before the casts into the parameter types,
+		// `void *` hides what builtins need to know of the pointee
+		std::vector<TypeView> args_type;
+		for ( auto &arg : args )
+		{
+			args_type.emplace_back( arg.get_type() );
+		}
+		std::vector<Value *> args_val;
+		for ( auto i = 0; i != args.size(); ++i )
+		{
+			if ( args[ i ].is_lvalue ) INTERNAL_ERROR();
+
+			args_val.emplace_back(
+			  i < fn->args.size() ? args[ i ].cast(
+											   TypeView( std::make_shared<QualifiedType>(
+												 fn->args[ i ].type ) ),
+											   children[ i + 2 ] )
+									  .get()
+								  : args[ i ].get() );
+		}
+		this->type.next();
+		if ( auto builtin = lower_libcall( this->val, args_type, args_val ) )
+		{
+			this->val = builtin;
+		}
+		else
+		{
+			std::vector<QualifiedDecl> va_args;
+			for ( auto i = fn->args.size(); i < args_type.size(); ++i )
+			{
+				va_args.emplace_back( args_type[ i ].into_type() );
+			}
+			auto abi_info = fn->call_abi_info( va_args );
+			std::vector<Value *> call_args;
+			Value *sret = nullptr;
+			if ( abi_info.ret.kind == abi::Indirect )
+			{
+				sret = abi::create_temporary( this->type->type );
+				call_args.emplace_back( sret );
+			}
+			for ( auto i = 0; i != args_val.size(); ++i )
+			{
+				call_args.emplace_back( abi::lower_argument( abi_info.args[ i ], args_val[ i ] ) );
+			}
+			auto callee = this->val;
+			auto callee_type = PointerType::getUnqual( abi_info.type );
+			if ( callee->getType() != callee_type )
+			{  // declared while one of its aggregates was incomplete
+				callee = Builder.CreateBitCast( callee, callee_type );
+			}
+			auto call = Builder.CreateCall( callee, call_args );
+			abi::apply_attributes( call, abi_info );
+			this->val = abi::lower_result( abi_info.ret, call, sret, this->type->type );
+			this->is_lvalue = this->is_temporary = abi_info.ret.kind != abi::Direct;
+		}
+	}
+	else
+	{
+		infoList->add_msg(
+		  MSG_TYPE_ERROR,
+		  fmt( "called object type `", type,
+			   "` is not a function or function pointer" ),
+		  children[ 0 ] );
+		HALT();
+	}
+
+	return *this;
+}
+
+QualifiedValue &QualifiedValue::cast_vector( const TypeView &dst, Json::Value &node, bool warn )
+{
+	if ( dst.is_same_discard_qualifiers( this->type ) )
+	{
+		this->type = dst;
+		return *this;
+	}
+
+	// an explicit cast reinterprets the bits of a vector or scalar of the same size
+	auto is_bits = []( const TypeView &type ) {
+		return type->is<mty::Vector>() || type->is<mty::Arithmetic>();
+	};
+	if ( !warn && is_bits( dst ) && is_bits( this->type ) &&
+		 TheDataLayout->getTypeSizeInBits( dst->type ) == TheDataLayout->getTypeSizeInBits( this->type->type ) )
+	{
+		this->type = dst;
+		this->val = Builder.CreateBitCast( this->val, dst->type );
+		return *this;
+	}
+
+	infoList->add_msg(
+	  MSG_TYPE_ERROR,
+	  fmt( "casting to `", dst, "` from incompatible type `", this->type, "`" ),
+	  node );
+	HALT();
+}
+
+QualifiedValue &QualifiedValue::convert_vector( const TypeView &dst, Json::Value &node )
+{
+	auto src_vec = this->type->as<mty::Vector>();
+	auto dst_vec = dst->as<mty::Vector>();
+	if ( !src_vec || !dst_vec )
+	{
+		infoList->add_msg(
+		  MSG_TYPE_ERROR,
+		  fmt( "cannot convert `", this->type, "` to `", dst, "`, vector types are required" ),
+		  node );
+		HALT();
+	}
+	if ( src_vec->len != dst_vec->len )
+	{
+		infoList->add_msg(
+		  MSG_TYPE_ERROR,
+		  fmt( "cannot convert `", this->type, "` to `", dst, "` with a different number of elements" ),
+		  node );
+		HALT();
+	}
+
+	auto src_elem = this->type;
+	auto dst_elem = dst;
+	auto src_int = src_elem.next()->as<mty::Integer>();
+	auto dst_int = dst_elem.next()->as<mty::Integer>();
+
+	if ( src_int && dst_int )
+	{
+		this->val = Builder.CreateIntCast( this->val, dst->type, src_int->is_signed );
+	}
+	else if ( src_int )
+	{
+		this->val = src_int->is_signed ? Builder.CreateSIToFP( this->val, dst->type )
+									   : Builder.CreateUIToFP( this->val, dst->type );
+	}
+	else if ( dst_int )
+	{
+		this->val = dst_int->is_signed ? Builder.CreateFPToSI( this->val, dst->type )
+									   : Builder.CreateFPToUI( this->val, dst->type );
+	}
+	else
+	{
+		this->val = Builder.CreateFPCast( this->val, dst->type );
+	}
+	this->type = dst;
+
+	return *this;
+}
+
+QualifiedValue &QualifiedValue::get_element( QualifiedValue &index, Json::Value &ast )
+{
+	auto &children = ast[ "children" ];
+	auto vec = this->type->as<mty::Vector>();
+	if ( !vec ) INTERNAL_ERROR();
+
+	index.value( children[ 2 ] );
+	if ( !index.type->is<mty::Integer>() )
+	{
+		infoList->add_msg(
+		  MSG_TYPE_ERROR,
+		  fmt( "vector subscript is not an integer" ),
+		  children[ 2 ] );
+		HALT();
+	}
+	if ( auto ci = dyn_cast<ConstantInt>( index.val ) )
+	{
+		if ( ci->getValue().uge( vec->len ) )
+		{
+			infoList->add_msg(
+			  MSG_TYPE_WARNING,
+			  fmt( "vector index is out of bounds, the vector has ", vec->len, " elements" ),
+			  children[ 2 ] );
+		}
+	}
+
+	auto is_const = this->type->is_const;
+	auto is_volatile = this->type->is_volatile;
+	this->type.next();
+	auto builder = DeclarationSpecifiers()
+					 .add_type( this->type.into_type(), ast );
+	if ( is_const ) builder.add_attribute( "const", ast );
+	if ( is_volatile ) builder.add_attribute( "volatile", ast );
+	this->type = TypeView( std::make_shared<QualifiedType>(
+	  builder
+		.into_type_builder( ast )
+		.build() ) );
+
+	if ( is_lvalue )
+	{  // selected lazily, so that the element can be assigned
+		this->lane = index.val;
+	}
+	else
+	{
+		this->val = Builder.CreateExtractElement( this->val, index.val );
+	}
+
+	return *this;
+}
+
+QualifiedValue &QualifiedValue::materialize( const std::string &name )
+{
+	if ( !this->val )
+	{
+		this->val = materialize_global( name, this->type );
+	}
+	return *this;
+}
@@ -8,6 +8,8 @@ private:
 	TypeView type;
 	Value *val;
 	bool is_lvalue;
+	bool is_temporary = false;  // an aggregate returned by a call, addressable but not assignable
+	Value *lane = nullptr;		// index of the selected element when this lvalue is an element of a vector
 
 public:
 	QualifiedValue( const TypeView &type, Value *val, bool is_lvalue = false ) :
@@ -35,11 +37,15 @@ public:
 	}
 	bool is_rvalue() const
 	{
-		return !is_lvalue;
+		return !is_lvalue || is_temporary;
+	}
+	bool is_vector_element() const
+	{
+		return lane != nullptr;
 	}
 	QualifiedValue &store( QualifiedValue &val, Json::Value &lhs, Json::Value &rhs, bool ignore_const = false )
 	{
-		if ( !is_lvalue )
+		if ( is_rvalue() )
 		{
 			infoList->add_msg( MSG_TYPE_ERROR,
 							   fmt( "expression is not assignable" ),
@@ -67,17 +73,25 @@ public:
 
 		this->deref( lhs );
 
-		Builder.CreateStore( val.value( rhs ).cast( type, rhs ).get(), this->val );
+		auto rhs_val = val.value( rhs ).cast( type, rhs ).get();
+		if ( lane )
+		{
+			auto vec = Builder.CreateLoad( this->val );
+			Builder.CreateStore( Builder.CreateInsertElement( vec, rhs_val, lane ), this->val );
+		}
+		else if ( type->is<mty::Structural>() )
+		{
+			abi::store_aggregate( rhs_val, this->val, type->is_volatile );
+		}
+		else
+		{
+			Builder.CreateStore( rhs_val, this->val );
+		}
 
 		return *this;
 	}
 	QualifiedValue &get_member( std::string const &member, Json::Value &ast )
 	{
-		if ( !is_lvalue )
-		{
-			UNIMPLEMENTED( "function returning a struct is not implemented yet" );
-		}
-
 		auto &children = ast[ "children" ];
 		if ( !type->is<mty::Structural>() )
 		{
@@ -87,6 +101,11 @@ public:
 			  children[ 0 ] );
 			HALT();
 		}
+		if ( !is_lvalue )
+		{  // e.g. member of a conditional expression, spill it to memory
+			this->val = abi::materialize_aggregate( this->val );
+			this->is_lvalue = this->is_temporary = true;
+		}
 		if ( auto struct_obj = type->as<mty::Struct>() )
 		{
 			auto &mem = struct_obj->get_member( member, children[ 2 ] );
@@ -144,7 +163,12 @@ public:
 		if ( is_lvalue )
 		{
 			val = Builder.CreateLoad( val );
-			is_lvalue = false;
+			if ( lane )
+			{
+				val = Builder.CreateExtractElement( val, lane );
+				lane = nullptr;
+			}
+			is_lvalue = is_temporary = false;
 		}
 		return *this;
 	}
@@ -196,61 +220,9 @@ public:
 
 		return *this;
 	}
-	QualifiedValue &call( std::vector<QualifiedValue> &args, Json::Value &ast )
-	{
-		if ( is_lvalue )
-		{
-			INTERNAL_ERROR();
-		}
-
-		auto &children = ast[ "children" ];
-		while ( type->is<mty::Pointer>() )
-		{
-			deref( children[ 0 ] ).value( children[ 0 ] );
-		}
-
-		if ( auto fn = type->as<mty::Function>() )
-		{
-			if ( fn->is_va_args && args.size() < fn->args.size() ||
-				 !fn->is_va_args && args.size() != fn->args.size() )
-			{
-				infoList->add_msg(
-				  MSG_TYPE_ERROR,
-				  fmt( "too ", args.size() > fn->args.size() ? "many" : "few",
-					   " arguments to function call, exprected ",
-					   fn->is_va_args ? "at least " : "", fn->args.size(),
-					   ", have ", args.size() ),
-				  ast );
-				HALT();
-			}
-			std::vector<Value *> args_val;
-			for ( auto i = 0; i != args.size(); ++i )
-			{
-				if ( args[ i ].is_lvalue ) INTERNAL_ERROR();
-
-				args_val.emplace_back(
-				  i < fn->args.size() ? args[ i ].cast(
-												   TypeView( std::make_shared<QualifiedType>(
-													 fn->args[ i ].type ) ),
-												   children[ i + 2 ] )
-										  .get()
-									  : args[ i ].get() );
-			}
-			this->type.next();
-			this->val = Builder.CreateCall( this->val, args_val );
-		}
-		else
-		{
-			infoList->add_msg(
-			  MSG_TYPE_ERROR,
-			  fmt( "called object type `", type,
-				   "` is not a function or function pointer" ),
-			  children[ 0 ] );
-			HALT();
-		}
-
-		return *this;
-	}
+	QualifiedValue &call( std::vector<QualifiedValue> &args, Json::Value &ast );
+	QualifiedValue &get_element( QualifiedValue &index, Json::Value &ast );
+	QualifiedValue &materialize( const std::string &name );
 
 	QualifiedValue &ensure_is_ptr_if_deref()
 	{
@@ -270,6 +242,11 @@ public:
 
 private:
 	static bool deref_into_ptr_unwrap( TypeView &view, Value *&val );
+	static Value *lower_libcall( Value *callee, const std::vector<TypeView> &args_type,
+								 const std::vector<Value *> &args_val );
+	static void cast_binary_vector( QualifiedValue &self, QualifiedValue &other, Json::Value &node, bool allow_float,
+									BasicBlock *lhs, BasicBlock *rhs );
+	QualifiedValue &cast_vector( const TypeView &dst, Json::Value &node, bool warn );
 
 public:
 	static bool cast_binary_ptr( QualifiedValue &self, QualifiedValue &other, Json::Value &node, bool supress_warning = false );
@@ -278,4 +255,5 @@ public:
 	static void cast_ternary_expr( QualifiedValue &self, QualifiedValue &other, Json::Value &node,
 								   BasicBlock *lhs = nullptr, BasicBlock *rhs = nullptr );
 	QualifiedValue &cast( const TypeView &dst, Json::Value &node, bool warn = true );
+	QualifiedValue &convert_vector( const TypeView &dst, Json::Value &node );
 };
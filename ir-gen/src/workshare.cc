@@ -0,0 +1,320 @@
+#include "workshare.h"
+#include "global.h"
+
+#include "llvm/ADT/Triple.h"
+
+static FunctionType *body_type()
+{
+	auto i8p = Type::getInt8PtrTy( TheContext );
+	return FunctionType::get( Type::getVoidTy( TheContext ), { i8p, i8p }, false );
+}
+
+static FunctionType *runtime_type( const std::string &name )
+{
+	auto i8p = Type::getInt8PtrTy( TheContext );
+	auto i32 = Type::getInt32Ty( TheContext );
+	auto i64 = Type::getInt64Ty( TheContext );
+	auto vd = Type::getVoidTy( TheContext );
+
+	if ( name == "__mcc_omp_parallel_for" )
+	{
+		return FunctionType::get( vd, { body_type()->getPointerTo(), i8p, i64, i64, i32, i32 }, false );
+	}
+	if ( name == "__mcc_omp_next" )
+	{
+		return FunctionType::get( Type::getInt1Ty( TheContext ), { i8p, i64->getPointerTo(), i64->getPointerTo() }, false );
+	}
+	if ( name == "__mcc_omp_lock" || name == "__mcc_omp_unlock" )
+	{
+		return FunctionType::get( vd, false );
+	}
+	INTERNAL_ERROR();
+}
+
+Function *workshare_function( const std::string &name )
+{
+	if ( auto fn = TheModule->getFunction( name ) ) return fn;
+	auto fn = Function::Create( runtime_type( name ), GlobalValue::ExternalLinkage, name, TheModule.get() );
+	fn->addFnAttr( Attribute::NoUnwind );
+	return fn;
+}
+
+// every object using the runtime carries a copy, the linker keeps one
+static Function *define( const std::string &name, IRBuilder<> &b )
+{
+	auto fn = workshare_function( name );
+	fn->setLinkage( GlobalValue::LinkOnceODRLinkage );
+	b.SetInsertPoint( BasicBlock::Create( TheContext, "entry", fn ) );
+	return fn;
+}
+
+static Function *define_internal( const std::string &name, FunctionType *type, IRBuilder<> &b )
+{
+	auto fn = Function::Create( type, GlobalValue::InternalLinkage, name, TheModule.get() );
+	fn->addFnAttr( Attribute::NoUnwind );
+	b.SetInsertPoint( BasicBlock::Create( TheContext, "entry", fn ) );
+	return fn;
+}
+
+// a spin lock, pthread_mutex_t has no portable layout to put in a global
+static void define_lock( IRBuilder<> &b )
+{
+	auto flag = new GlobalVariable( *TheModule, b.getInt32Ty(), false, GlobalValue::LinkOnceODRLinkage,
+									b.getInt32( 0 ), "__mcc_omp_critical" );
+	flag->setAlignment( 4 );
+
+	auto lock = define( "__mcc_omp_lock", b );
+	auto spin = BasicBlock::Create( TheContext, "spin", lock );
+	auto done = BasicBlock::Create( TheContext, "done", lock );
+	b.CreateBr( spin );
+	b.SetInsertPoint( spin );
+	auto pair = b.CreateAtomicCmpXchg( flag, b.getInt32( 0 ), b.getInt32( 1 ),
+									   AtomicOrdering::Acquire, AtomicOrdering::Monotonic );
+	b.CreateCondBr( b.CreateExtractValue( pair, 1 ), done, spin );
+	b.SetInsertPoint( done );
+	b.CreateRetVoid();
+
+	define( "__mcc_omp_unlock", b );
+	auto release = b.CreateStore( b.getInt32( 0 ), flag );
+	release->setAtomic( AtomicOrdering::Release );
+	release->setAlignment( 4 );
+	b.CreateRetVoid();
+}
+
+// team: { body, ctx, i64 trip, i64 chunk, i64 next, i32 dynamic, i32 threads }
+// thread: { team *, i64 cursor, pthread_t handle, i32 started }
+static void define_next( StructType *team, StructType *thread, IRBuilder<> &b )
+{
+	auto next = define( "__mcc_omp_next", b );
+	auto args = next->arg_begin();
+	auto self = b.CreateBitCast( &*args++, thread->getPointerTo() );
+	Value *lo = &*args++;
+	Value *hi = &*args;
+
+	auto shared = b.CreateLoad( b.CreateStructGEP( thread, self, 0 ) );
+	auto trip = b.CreateLoad( b.CreateStructGEP( team, shared, 2 ) );
+	auto chunk = b.CreateLoad( b.CreateStructGEP( team, shared, 3 ) );
+	auto dynamic = b.CreateLoad( b.CreateStructGEP( team, shared, 5 ) );
+
+	auto stat = BasicBlock::Create( TheContext, "static", next );
+	auto dyn = BasicBlock::Create( TheContext, "dynamic", next );
+	auto check = BasicBlock::Create( TheContext, "check", next );
+	auto take = BasicBlock::Create( TheContext, "take", next );
+	auto done = BasicBlock::Create( TheContext, "done", next );
+	b.CreateCondBr( b.CreateICmpNE( dynamic, b.getInt32( 0 ) ), dyn, stat );
+
+	// the chunks of a thread are a team's worth of chunks apart
+	b.SetInsertPoint( stat );
+	auto cursor = b.CreateStructGEP( thread, self, 1 );
+	auto mine = b.CreateLoad( cursor );
+	auto threads = b.CreateZExt( b.CreateLoad( b.CreateStructGEP( team, shared, 6 ) ), b.getInt64Ty() );
+	b.CreateStore( b.CreateAdd( mine, b.CreateMul( threads, chunk ) ), cursor );
+	b.CreateBr( check );
+
+	// whoever comes first takes the next chunk
+	b.SetInsertPoint( dyn );
+	auto taken = b.CreateAtomicRMW( AtomicRMWInst::Add, b.CreateStructGEP( team, shared, 4 ), chunk,
+									AtomicOrdering::Monotonic );
+	b.CreateBr( check );
+
+	b.SetInsertPoint( check );
+	auto first = b.CreatePHI( b.getInt64Ty(), 2 );
+	first->addIncoming( mine, stat );
+	first->addIncoming( taken, dyn );
+	b.CreateCondBr( b.CreateICmpSLT( first, trip ), take, done );
+
+	b.SetInsertPoint( take );
+	auto end = b.CreateAdd( first, chunk );
+	b.CreateStore( first, lo );
+	b.CreateStore( b.CreateSelect( b.CreateICmpSLT( end, trip ), end, trip ), hi );
+	b.CreateRet( b.getTrue() );
+
+	b.SetInsertPoint( done );
+	b.CreateRet( b.getFalse() );
+}
+
+// OMP_NUM_THREADS, or one thread per online cpu
+static Function *define_threads( IRBuilder<> &b )
+{
+	auto i8p = b.getInt8PtrTy();
+	auto i64 = b.getInt64Ty();
+	auto getenv = TheModule->getOrInsertFunction( "getenv", FunctionType::get( i8p, { i8p }, false ) );
+	auto atoi = TheModule->getOrInsertFunction( "atoi", FunctionType::get( b.getInt32Ty(), { i8p }, false ) );
+	auto sysconf = TheModule->getOrInsertFunction(
+	  "sysconf", FunctionType::get( TheDataLayout->getIntPtrType( TheContext ), { b.getInt32Ty() }, false ) );
+
+	auto count = define_internal( "__mcc_omp_threads", FunctionType::get( i64, false ), b );
+	auto set = BasicBlock::Create( TheContext, "set", count );
+	auto valid = BasicBlock::Create( TheContext, "valid", count );
+	auto cpus = BasicBlock::Create( TheContext, "cpus", count );
+
+	auto env = b.CreateCall( getenv, { b.CreateGlobalStringPtr( "OMP_NUM_THREADS" ) } );
+	b.CreateCondBr( b.CreateIsNull( env ), cpus, set );
+
+	b.SetInsertPoint( set );
+	auto n = b.CreateSExt( b.CreateCall( atoi, { env } ), i64 );
+	b.CreateCondBr( b.CreateICmpSGT( n, b.getInt64( 0 ) ), valid, cpus );
+
+	b.SetInsertPoint( valid );
+	b.CreateRet( n );
+
+	// _SC_NPROCESSORS_ONLN, the bsds and darwin agree on theirs
+	b.SetInsertPoint( cpus );
+	auto online = Triple( TheModule->getTargetTriple() ).isOSLinux() ? 84 : 58;
+	auto c = b.CreateSExtOrTrunc( b.CreateCall( sysconf, { b.getInt32( online ) } ), i64 );
+	b.CreateRet( b.CreateSelect( b.CreateICmpSGT( c, b.getInt64( 0 ) ), c, b.getInt64( 1 ) ) );
+
+	return count;
+}
+
+static void define_parallel_for( StructType *team, StructType *thread, IRBuilder<> &b )
+{
+	auto i8p = b.getInt8PtrTy();
+	auto i32 = b.getInt32Ty();
+	auto i64 = b.getInt64Ty();
+	auto zero = b.getInt64( 0 );
+	auto one = b.getInt64( 1 );
+
+	auto count = define_threads( b );
+
+	// the body of every thread but the calling one
+	auto start = define_internal( "__mcc_omp_start", FunctionType::get( i8p, { i8p }, false ), b );
+	{
+		auto arg = &*start->arg_begin();
+		auto self = b.CreateBitCast( arg, thread->getPointerTo() );
+		auto shared = b.CreateLoad( b.CreateStructGEP( thread, self, 0 ) );
+		b.CreateCall( b.CreateLoad( b.CreateStructGEP( team, shared, 0 ) ),
+					  { b.CreateLoad( b.CreateStructGEP( team, shared, 1 ) ), arg } );
+		b.CreateRet( ConstantPointerNull::get( i8p ) );
+	}
+
+	// pthread_t is an integer or a pointer, either way of pointer size
+	auto handle = TheDataLayout->getIntPtrType( TheContext );
+	auto create = TheModule->getOrInsertFunction(
+	  "pthread_create", FunctionType::get( i32, { handle->getPointerTo(), i8p, start->getType(), i8p }, false ) );
+	auto join = TheModule->getOrInsertFunction(
+	  "pthread_join", FunctionType::get( i32, { handle, i8p->getPointerTo() }, false ) );
+
+	auto fn = define( "__mcc_omp_parallel_for", b );
+	auto args = fn->arg_begin();
+	Value *body = &*args++;
+	Value *ctx = &*args++;
+	Value *trip = &*args++;
+	Value *chunk = &*args++;
+	Value *dynamic = &*args++;
+	Value *threads = &*args;
+
+	auto setup = BasicBlock::Create( TheContext, "setup", fn );
+	auto spawn_cond = BasicBlock::Create( TheContext, "spawn.cond", fn );
+	auto spawn = BasicBlock::Create( TheContext, "spawn", fn );
+	auto spawn_inline = BasicBlock::Create( TheContext, "spawn.inline", fn );
+	auto spawn_next = BasicBlock::Create( TheContext, "spawn.next", fn );
+	auto run = BasicBlock::Create( TheContext, "run", fn );
+	auto join_cond = BasicBlock::Create( TheContext, "join.cond", fn );
+	auto join_check = BasicBlock::Create( TheContext, "join.check", fn );
+	auto join_wait = BasicBlock::Create( TheContext, "join.wait", fn );
+	auto join_next = BasicBlock::Create( TheContext, "join.next", fn );
+	auto done = BasicBlock::Create( TheContext, "done", fn );
+
+	auto shared = b.CreateAlloca( team, nullptr, "team" );
+	b.CreateCondBr( b.CreateICmpSGT( trip, zero ), setup, done );
+
+	// without a chunk size the iterations are split evenly, or handed out one
+	// at a time, and no thread is started without a chunk to run
+	b.SetInsertPoint( setup );
+	auto wanted = b.CreateSelect( b.CreateICmpEQ( threads, b.getInt32( 0 ) ),
+								  b.CreateCall( count ), b.CreateZExt( threads, i64 ) );
+	auto even = b.CreateSDiv( b.CreateAdd( trip, b.CreateSub( wanted, one ) ), wanted );
+	auto is_dynamic = b.CreateICmpNE( dynamic, b.getInt32( 0 ) );
+	auto size = b.CreateSelect( b.CreateICmpEQ( chunk, zero ), b.CreateSelect( is_dynamic, one, even ), chunk );
+	auto chunks = b.CreateSDiv( b.CreateAdd( trip, b.CreateSub( size, one ) ), size );
+	auto n = b.CreateSelect( b.CreateICmpSLT( chunks, wanted ), chunks, wanted );
+
+	b.CreateStore( body, b.CreateStructGEP( team, shared, 0 ) );
+	b.CreateStore( ctx, b.CreateStructGEP( team, shared, 1 ) );
+	b.CreateStore( trip, b.CreateStructGEP( team, shared, 2 ) );
+	b.CreateStore( size, b.CreateStructGEP( team, shared, 3 ) );
+	b.CreateStore( zero, b.CreateStructGEP( team, shared, 4 ) );
+	b.CreateStore( dynamic, b.CreateStructGEP( team, shared, 5 ) );
+	b.CreateStore( b.CreateTrunc( n, i32 ), b.CreateStructGEP( team, shared, 6 ) );
+
+	auto members = b.CreateAlloca( thread, n, "threads" );
+	auto member = [&]( Value *index ) {
+		auto self = b.CreateGEP( thread, members, index );
+		b.CreateStore( shared, b.CreateStructGEP( thread, self, 0 ) );
+		b.CreateStore( b.CreateMul( index, size ), b.CreateStructGEP( thread, self, 1 ) );
+		b.CreateStore( b.getInt32( 0 ), b.CreateStructGEP( thread, self, 3 ) );
+		return self;
+	};
+	b.CreateBr( spawn_cond );
+
+	// thread 0 is the calling one, it starts the others first
+	b.SetInsertPoint( spawn_cond );
+	auto i = b.CreatePHI( i64, 2 );
+	i->addIncoming( one, setup );
+	b.CreateCondBr( b.CreateICmpSLT( i, n ), spawn, run );
+
+	b.SetInsertPoint( spawn );
+	auto self = member( i );
+	auto arg = b.CreateBitCast( self, i8p );
+	auto rc = b.CreateCall( create, { b.CreateStructGEP( thread, self, 2 ), ConstantPointerNull::get( i8p ), start, arg } );
+	auto started = b.CreateICmpEQ( rc, b.getInt32( 0 ) );
+	b.CreateStore( b.CreateZExt( started, i32 ), b.CreateStructGEP( thread, self, 3 ) );
+	b.CreateCondBr( started, spawn_next, spawn_inline );
+
+	// out of threads, the share is run right away instead
+	b.SetInsertPoint( spawn_inline );
+	b.CreateCall( start, { arg } );
+	b.CreateBr( spawn_next );
+
+	b.SetInsertPoint( spawn_next );
+	i->addIncoming( b.CreateAdd( i, one ), spawn_next );
+	b.CreateBr( spawn_cond );
+
+	b.SetInsertPoint( run );
+	b.CreateCall( start, { b.CreateBitCast( member( zero ), i8p ) } );
+	b.CreateBr( join_cond );
+
+	b.SetInsertPoint( join_cond );
+	auto j = b.CreatePHI( i64, 2 );
+	j->addIncoming( one, run );
+	b.CreateCondBr( b.CreateICmpSLT( j, n ), join_check, done );
+
+	b.SetInsertPoint( join_check );
+	auto waited = b.CreateGEP( thread, members, j );
+	b.CreateCondBr( b.CreateICmpNE( b.CreateLoad( b.CreateStructGEP( thread, waited, 3 ) ), b.getInt32( 0 ) ),
+					join_wait, join_next );
+
+	b.SetInsertPoint( join_wait );
+	b.CreateCall( join, { b.CreateLoad( b.CreateStructGEP( thread, waited, 2 ) ),
+						  ConstantPointerNull::get( i8p->getPointerTo() ) } );
+	b.CreateBr( join_next );
+
+	b.SetInsertPoint( join_next );
+	j->addIncoming( b.CreateAdd( j, one ), join_next );
+	b.CreateBr( join_cond );
+
+	b.SetInsertPoint( done );
+	b.CreateRetVoid();
+}
+
+void define_workshare_runtime()
+{
+	// the modules of parallel ir generation bring their copies along
+	auto parallel_for = TheModule->getFunction( "__mcc_omp_parallel_for" );
+	if ( !parallel_for || !parallel_for->isDeclaration() ) return;
+
+	auto i64 = Type::getInt64Ty( TheContext );
+	auto i32 = Type::getInt32Ty( TheContext );
+	auto i8p = Type::getInt8PtrTy( TheContext );
+	auto team = StructType::create( TheContext, { body_type()->getPointerTo(), i8p, i64, i64, i64, i32, i32 },
+									"mcc.omp.team" );
+	auto thread = StructType::create( TheContext, { team->getPointerTo(), i64,
+													TheDataLayout->getIntPtrType( TheContext ), i32 },
+									  "mcc.omp.thread" );
+
+	IRBuilder<> b( TheContext );
+	define_lock( b );
+	define_next( team, thread, b );
+	define_parallel_for( team, thread, b );
+}
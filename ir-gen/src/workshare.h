@@ -0,0 +1,19 @@
+#pragma once
+
+#include "common.h"
+
+// the work-sharing runtime of `#pragma omp parallel for`. It is bundled
+// with the code instead of linked in: the loops only declare what they
+// call, `define_workshare_runtime` gives the declarations their bodies
+// once the module is complete and user declarations of pthreads are known.
+//
+//   void __mcc_omp_parallel_for( void ( *body )( i8 *ctx, i8 *thread ), i8 *ctx,
+//                                i64 trip, i64 chunk, i32 dynamic, i32 threads )
+//     runs `body` on a team of threads, each takes its iterations of [ 0, trip )
+//   i1 __mcc_omp_next( i8 *thread, i64 *lo, i64 *hi )
+//     the next range of iterations of the calling thread, false when done
+//   void __mcc_omp_lock(), void __mcc_omp_unlock()
+//     one lock around the combination of reductions
+Function *workshare_function( const std::string &name );
+
+void define_workshare_runtime();
@@ -0,0 +1,133 @@
+/* content addressed compilation cache
+ *
+ * Entries live in `<dir>/<xx>/<key>.<suffix>`. The key hashes the
+ * preprocessed translation unit together with everything else that
+ * changes the output (mcc build, output kind, target, flags). Entries
+ * are written to a temporary file and renamed into place, so concurrent
+ * mcc processes can share a directory. The mtime of an entry is its last
+ * use, and the least recently used entries are dropped once the
+ * directory grows over its size limit.
+ */
+
+use std::fs;
+use std::io::Result;
+use std::path::{Path, PathBuf};
+use std::time::{SystemTime, UNIX_EPOCH};
+
+use crate::sha256::{self, Sha256};
+
+pub const DEFAULT_MAX_SIZE: u64 = 1 << 30;
+
+pub struct Cache {
+    dir: PathBuf,
+    max_size: u64,
+}
+
+pub struct Key(String);
+
+impl Key {
+    /* `parts` is everything but the source that affects the output */
+    pub fn new(source: &str, parts: &[String]) -> Self {
+        /* the build id changes with any source of mcc, see build.rs */
+        let mut hasher = Sha256::new();
+        hasher.field(env!("MCC_BUILD_ID").as_bytes());
+        for part in parts {
+            hasher.field(part.as_bytes());
+        }
+        hasher.field(source.as_bytes());
+        Key(hasher.finish())
+    }
+}
+
+/* digest of the contents of `path`, empty if it cannot be read */
+pub fn file_digest(path: &str) -> String {
+    fs::read(path).map_or(String::new(), |data| sha256::digest(&data))
+}
+
+impl Cache {
+    pub fn new(dir: &str, max_size: u64) -> Self {
+        Cache {
+            dir: PathBuf::from(dir),
+            max_size: max_size,
+        }
+    }
+
+    fn entry(&self, key: &Key, suffix: &str) -> PathBuf {
+        self.dir.join(&key.0[..2]).join(format!("{}{}", key.0, suffix))
+    }
+
+    /* copy the entry for `key` to `out`, false on a miss */
+    pub fn fetch(&self, key: &Key, suffix: &str, out: &str) -> bool {
+        let entry = self.entry(key, suffix);
+        if fs::copy(&entry, out).is_err() {
+            return false;
+        }
+        touch(&entry);
+        true
+    }
+
+    /* publish `file` as the entry for `key` */
+    pub fn store(&self, key: &Key, suffix: &str, file: &str) -> Result<()> {
+        let entry = self.entry(key, suffix);
+        let parent = entry.parent().unwrap();
+        fs::create_dir_all(parent)?;
+
+        let nanos = SystemTime::now()
+            .duration_since(UNIX_EPOCH)
+            .map_or(0, |x| x.subsec_nanos());
+        let tmp = parent.join(format!(".tmp.{}.{}", std::process::id(), nanos));
+        if let Err(err) = fs::copy(file, &tmp).and_then(|_| fs::rename(&tmp, &entry)) {
+            let _ = fs::remove_file(&tmp);
+            return Err(err);
+        }
+
+        self.evict();
+        Ok(())
+    }
+
+    /* drop least recently used entries until we are back under 90% of the limit */
+    fn evict(&self) {
+        let mut entries = vec![];
+        let mut total = 0;
+        for sub in fs::read_dir(&self.dir).into_iter().flatten().flatten() {
+            for file in fs::read_dir(sub.path()).into_iter().flatten().flatten() {
+                if file.file_name().to_string_lossy().starts_with(".tmp.") {
+                    continue;
+                }
+                if let Ok(meta) = file.metadata() {
+                    let used = meta.modified().unwrap_or(UNIX_EPOCH);
+                    total += meta.len();
+                    entries.push((used, meta.len(), file.path()));
+                }
+            }
+        }
+        if total <= self.max_size {
+            return;
+        }
+        entries.sort();
+        for (_, len, path) in entries.iter() {
+            if total <= self.max_size / 10 * 9 {
+                break;
+            }
+            /* somebody else may be evicting too */
+            if fs::remove_file(path).is_ok() {
+                total -= len;
+            }
+        }
+    }
+}
+
+#[cfg(unix)]
+fn touch(path: &Path) {
+    use std::ffi::CString;
+    use std::os::unix::ffi::OsStrExt;
+
+    if let Ok(path) = CString::new(path.as_os_str().as_bytes()) {
+        unsafe {
+            libc::utime(path.as_ptr(), std::ptr::null());
+        }
+    }
+}
+
+#[cfg(not(unix))]
+fn touch(_: &Path) {}
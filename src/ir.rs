@@ -1,31 +1,79 @@
 use super::msg::*;
 use myrpg::*;
 
-use std::ffi::{CStr, CString};
-use std::os::raw::c_char;
+use std::ffi::CString;
+use std::io::Write;
+use std::os::raw::{c_char, c_void};
+
+type IrSink = extern "C" fn(ctx: *mut c_void, chunk: *const c_char, len: usize);
 
 extern "C" {
-    fn gen_llvm_ir(ast_json: *const c_char) -> *const c_char;
-    fn free_llvm_ir(ir: *const c_char);
+    fn gen_llvm_ir(
+        prefix_json: *const c_char,
+        ast_json: *const c_char,
+        source: *const c_char,
+        sink: Option<IrSink>,
+        ctx: *mut c_void,
+    ) -> i32;
 }
 
-pub fn ir_gen<T>(ast: &Ast<T>) -> Result<String, ()> {
-    let ir_c: *const c_char;
+struct SinkCtx<'a> {
+    out: &'a mut dyn Write,
+    result: std::io::Result<()>,
+}
 
-    unsafe {
-        let ast_json_c = CString::new(ast.to_json().as_str()).unwrap();
-        ir_c = gen_llvm_ir(ast_json_c.as_ptr());
+extern "C" fn write_chunk(ctx: *mut c_void, chunk: *const c_char, len: usize) {
+    let ctx = unsafe { &mut *(ctx as *mut SinkCtx) };
+    if ctx.result.is_ok() {
+        let chunk = unsafe { std::slice::from_raw_parts(chunk as *const u8, len) };
+        ctx.result = ctx.out.write_all(chunk);
     }
+}
 
-    let ir = String::from(if ir_c == std::ptr::null() {
-        "".into()
-    } else {
-        unsafe { CStr::from_ptr(ir_c).to_str().unwrap() }
-    });
+/* `prefix_json` is the ast of a precompiled header, generated ahead of `ast`.
+ * `source` is the preprocessed text `ast` was parsed from, its line markers
+ * give the debug locations. The textual ir is written to `out` while it is printed, pass `None` when
+ * only the module kept by the backend is wanted */
+pub fn ir_gen<T>(
+    prefix_json: Option<&str>,
+    ast: &Ast<T>,
+    source: &str,
+    out: Option<&mut dyn Write>,
+) -> std::io::Result<()> {
+    let prefix_json_c = prefix_json.map(|x| CString::new(x).unwrap());
+    let ast_json_c = CString::new(ast.to_json().as_str()).unwrap();
+    let source_c = CString::new(source).unwrap();
+    let prefix_json_p = prefix_json_c.as_ref().map_or(std::ptr::null(), |x| x.as_ptr());
 
-    unsafe {
-        free_llvm_ir(ir_c);
+    /* failures are reported through the message list */
+    match out {
+        Some(out) => {
+            let mut ctx = SinkCtx {
+                out: out,
+                result: Ok(()),
+            };
+            unsafe {
+                gen_llvm_ir(
+                    prefix_json_p,
+                    ast_json_c.as_ptr(),
+                    source_c.as_ptr(),
+                    Some(write_chunk),
+                    &mut ctx as *mut SinkCtx as *mut c_void,
+                );
+            }
+            ctx.result
+        }
+        None => {
+            unsafe {
+                gen_llvm_ir(
+                    prefix_json_p,
+                    ast_json_c.as_ptr(),
+                    source_c.as_ptr(),
+                    None,
+                    std::ptr::null_mut(),
+                );
+            }
+            Ok(())
+        }
     }
-
-    Ok(ir)
 }
@@ -5,16 +5,32 @@ use regex::Regex;
 use std::collections::HashSet;
 use std::iter::FromIterator;
 
+fn builtin_types() -> HashSet<String> {
+    HashSet::from_iter(
+        [
+            "__builtin_va_list"
+        ]
+        .into_iter()
+        .map(|x| (*x).into())
+    )
+}
+
 ref_thread_local! {
-    static managed TYPE_SET: Vec<HashSet<String>> = vec![
-        HashSet::from_iter([
-                "__builtin_va_list"
-            ]
-            .into_iter()
-            .map(|x| (*x).into())
-        )
-    ];
+    static managed TYPE_SET: Vec<HashSet<String>> = vec![builtin_types()];
     static managed IS_TYPEDEF: bool = false;
+    static managed GLOBAL_TYPES: HashSet<String> = HashSet::new();
+}
+
+/* typedef names visible before the first token, e.g. from a precompiled header */
+pub fn set_predefined_types(names: &[String]) {
+    let mut types = builtin_types();
+    types.extend(names.iter().cloned());
+    TYPE_SET.borrow_mut()[0] = types;
+}
+
+/* typedef names declared at file scope of the last parsed translation unit */
+pub fn global_types() -> Vec<String> {
+    GLOBAL_TYPES.borrow().iter().cloned().collect()
 }
 
 lazy_static! {
@@ -110,7 +126,9 @@ lang! {
         ctrl.discard();
     },
     TYPE_NAME => r"$^$^",
-    FLOATING_POINT => r#"\d+[Ee][\+-]?\d+[fFlL]?\b|\d*\.\d+[fFlL]?\b|\d*\.\d+[Ee][\+-]?\d+[fFlL]?\b|\d+\.\d*[Ee][\+-]?\d+[fFlL]?\b|\d+\.\d*[fFlL]?\b"#,
+    LOOP_PRAGMA => r"$^$^",
+    ATTRIBUTE => r"$^$^",
+    FLOATING_POINT => r#"0[xX](?:[0-9A-Fa-f]*\.[0-9A-Fa-f]+|[0-9A-Fa-f]+\.?)[pP][\+-]?\d+[fFlL]?\b|\d+[Ee][\+-]?\d+[fFlL]?\b|\d*\.\d+[fFlL]?\b|\d*\.\d+[Ee][\+-]?\d+[fFlL]?\b|\d+\.\d*[Ee][\+-]?\d+[fFlL]?\b|\d+\.\d*[fFlL]?\b"#,
     INTEGER => r#"0[xX][0-9A-Fa-f]+[uUlL]*\b|\d+[uUlL]*\b"#,
     CHAR => r#"([a-zA-Z_]?'(:?[^\\']|\\.)*')"#,
     STRING_LITERAL => r#"([a-zA-Z_]?"(:?[^\\"]|\\.)*")"#,
@@ -136,7 +154,7 @@ lang! {
     ],
     global_end_trig => [
         _ |@flatten| => @reduce |ast| {
-            TYPE_SET.borrow_mut().pop();
+            *GLOBAL_TYPES.borrow_mut() = TYPE_SET.borrow_mut().pop().unwrap();
         }
     ],
     string_literal => [
@@ -152,7 +170,15 @@ lang! {
         CHAR,
         FLOATING_POINT,
         string_literal_i,
-        "(" expression ")"
+        "(" expression ")",
+        shuffle_vector_expression |@flatten|,
+        convert_vector_expression |@flatten|
+    ],
+    shuffle_vector_expression => [
+        "__builtin_shufflevector" "(" argument_expression_list ")"
+    ],
+    convert_vector_expression => [
+        "__builtin_convertvector" "(" assignment_expression "," type_name ")"
     ],
     postfix_expression => [
         primary_expression |@flatten|,
@@ -279,7 +305,9 @@ lang! {
         type_specifier |@flatten|,
         type_specifier declaration_specifiers |@flatten|,
         type_qualifier |@flatten|,
-        type_qualifier declaration_specifiers |@flatten|
+        type_qualifier declaration_specifiers |@flatten|,
+        ATTRIBUTE |@flatten|,
+        ATTRIBUTE declaration_specifiers |@flatten|
     ],
     init_declarator_list_i => [
         init_declarator_list |@flatten| => @reduce |ast| {
@@ -293,8 +321,16 @@ lang! {
         init_declarator_list "," init_declarator |@flatten|
     ],
     init_declarator => [
-        declarator,
-        declarator "=" initializer
+        attributed_declarator,
+        attributed_declarator "=" initializer
+    ],
+    attributed_declarator => [
+        declarator |@flatten|,
+        declarator attribute_specifier_list
+    ],
+    attribute_specifier_list => [
+        ATTRIBUTE |@flatten|,
+        attribute_specifier_list ATTRIBUTE |@flatten|
     ],
     storage_class_specifier => [
         "typedef" |@flatten|,
@@ -511,7 +547,8 @@ lang! {
         "while" "(" expression ")" statement,
         "do" statement "while" "(" expression ")" ";",
         "for" "(" expression_statement expression_statement ")" statement,
-        "for" "(" expression_statement expression_statement expression ")" statement
+        "for" "(" expression_statement expression_statement expression ")" statement,
+        LOOP_PRAGMA iteration_statement
     ],
     jump_statement => [
         "goto" IDENTIFIER ";",
@@ -69,6 +69,45 @@ impl CLexer {
     }
 }
 
+/* pragmas that annotate the following loop are kept as tokens,
+ * every other directive is dropped as a source map line */
+fn is_loop_pragma(line: &str) -> bool {
+    let mut words = line[1..].split_whitespace();
+    if words.next() != Some("pragma") {
+        return false;
+    }
+    match words.next() {
+        Some("unroll") | Some("nounroll") => true,
+        Some(word) if word.starts_with("unroll(") => true,
+        Some("clang") => words.next() == Some("loop"),
+        Some("omp") => words.next() == Some("parallel") && words.next() == Some("for"),
+        Some("GCC") => match words.next() {
+            Some("unroll") | Some("ivdep") => true,
+            _ => false,
+        },
+        _ => false,
+    }
+}
+
+/* `__attribute__ ((...))` is kept as a single token, returns its length */
+fn scan_attribute(input: &str, start: usize) -> Option<usize> {
+    let mut depth = 0;
+    for (i, c) in input[start..].char_indices() {
+        match c {
+            '(' => depth += 1,
+            ')' => {
+                depth -= 1;
+                if depth == 0 {
+                    return Some(start + i + 1);
+                }
+            }
+            _ if depth == 0 && !c.is_whitespace() => return None,
+            _ => {}
+        }
+    }
+    None
+}
+
 fn into_symbol(tok: &str) -> Symbol {
     Symbol::from(tok).as_terminal()
 }
@@ -122,7 +161,9 @@ impl LexerProvider for CLexer {
                 "goto",
                 "continue",
                 "break",
-                "return"
+                "return",
+                "__builtin_shufflevector",
+                "__builtin_convertvector"
             },
             delegate: DefaultRegexLexer::new(rules),
         }
@@ -130,11 +171,23 @@ impl LexerProvider for CLexer {
     fn emit(&self, input: &str) -> Option<(Symbol, usize)> {
         let mut chars = input.chars();
         match chars.next().unwrap() {
-            'a'..='z' | 'A'..='Z' | '_' => Some(self.trie_get(input)),
-            '#' => Some((
-                into_symbol("SOURCE_MAP"),
-                input.find('\n').map_or(input.len(), |x| x+1),
-            )),
+            'a'..='z' | 'A'..='Z' | '_' => {
+                let (symbol, end) = self.trie_get(input);
+                if let "__attribute__" | "__attribute" = &input[..end] {
+                    if let Some(len) = scan_attribute(input, end) {
+                        return Some((into_symbol("ATTRIBUTE"), len));
+                    }
+                }
+                Some((symbol, end))
+            }
+            '#' => {
+                let len = input.find('\n').map_or(input.len(), |x| x+1);
+                if is_loop_pragma(&input[..len]) {
+                    Some((into_symbol("LOOP_PRAGMA"), len))
+                } else {
+                    Some((into_symbol("SOURCE_MAP"), len))
+                }
+            }
             '0'..='9' | '\'' | '"' => self.delegate.emit(input),
             '.' => {
                 let a = chars.next();
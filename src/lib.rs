@@ -26,6 +26,19 @@ use lang::C;
 mod msg;
 use msg::*;
 
+mod opts;
+use opts::CompileOptions;
+
+mod cache;
+use cache::Cache;
+mod sha256;
+
+mod pch;
+use pch::Pch;
+
+#[cfg(unix)]
+mod server;
+
 use std::ffi::{CStr, CString};
 use std::fs::File;
 use std::io::prelude::*;
@@ -40,10 +53,12 @@ macro_rules! error_exit {
 }
 
 extern "C" {
-    fn init_be(dev: i32) -> *const MsgList;
+    fn init_be(opts: *const CompileOptions) -> *const MsgList;
     fn clear_msg();
     fn deinit_be();
-    fn irc_into_obj(out_file: *const c_char) -> i32;
+    fn irc_into_obj(out_file: *const c_char, record_file: *const c_char) -> i32;
+    fn irc_into_asm(out_file: *const c_char, record_file: *const c_char) -> i32;
+    fn irc_run(argc: i32, argv: *const *const c_char, exit_code: *mut i32) -> i32;
 }
 
 trait NextName {
@@ -58,7 +73,38 @@ impl NextName for String {
     }
 }
 
-fn main_rs(args: Vec<&str>) -> Result<(), std::io::Error> {
+/* the clang of the llvm mcc is built against, see build.rs: the profile and
+ * xray runtimes it links must match the instrumentation mcc emits */
+fn llvm_clang() -> Result<String, String> {
+    let version = env!("MCC_LLVM_VERSION");
+    if version.is_empty() {
+        return Err("mcc was built without llvm-config, the clang of its llvm is unknown".into());
+    }
+    let bundled = std::path::Path::new(env!("MCC_LLVM_BINDIR")).join("clang");
+    let clang = if bundled.is_file() {
+        bundled.to_string_lossy().into_owned()
+    } else {
+        String::from("clang")
+    };
+    let banner = Command::new(&clang)
+        .arg("--version")
+        .output()
+        .map_err(|err| format!("cannot run {}: {}", clang, err))?
+        .stdout;
+    let banner = String::from_utf8_lossy(&banner);
+    let major = version.split('.').next().unwrap();
+    if !banner.contains(&format!("version {}.", major)) {
+        return Err(format!(
+            "{} is not clang {} of the llvm mcc is built against: {}",
+            clang,
+            version,
+            banner.lines().next().unwrap_or("").trim()
+        ));
+    }
+    Ok(clang)
+}
+
+fn main_rs(args: Vec<&str>, parser: &LRParser<C, CLexer>) -> Result<(), std::io::Error> {
     let mut stderr = std::io::stderr();
 
     let matches = App::new("my")
@@ -93,9 +139,23 @@ fn main_rs(args: Vec<&str>) -> Result<(), std::io::Error> {
                 .long("target")
                 .multiple(false)
                 .possible_values(&[
-                    "ir", "ast", "obj", "elf"
+                    "ir", "ast", "obj", "asm", "elf", "run", "pch"
                 ])
         )
+        .arg(
+            Arg::with_name("include-pch")
+                .help("use a precompiled header built with -t pch")
+                .takes_value(true)
+                .long("include-pch")
+                .multiple(false)
+        )
+        .arg(
+            Arg::with_name("triple")
+                .help("generate code for the given target triple, defaults to the host")
+                .takes_value(true)
+                .long("triple")
+                .multiple(false)
+        )
         .arg(
             Arg::with_name("compile")
                 .help("compile but do not link")
@@ -109,23 +169,102 @@ fn main_rs(args: Vec<&str>) -> Result<(), std::io::Error> {
                 .takes_value(true)
                 .multiple(true)
         )
+        .arg(
+            Arg::with_name("debug-info")
+                .help("generate debug info")
+                .short("g")
+        )
+        .arg(
+            Arg::with_name("remark")
+                .help("report optimization remarks of the matching passes, e.g. -Rpass-missed=regalloc")
+                .short("R")
+                .takes_value(true)
+                .multiple(true)
+                .number_of_values(1)
+        )
+        .arg(
+            Arg::with_name("machine")
+                .help("set a machine option, e.g. -mcpu=znver1")
+                .short("m")
+                .takes_value(true)
+                .multiple(true)
+                .number_of_values(1)
+        )
+        .arg(
+            Arg::with_name("mca-report")
+                .help("report the throughput and port pressure of the innermost loops and `hot` functions on the -mcpu pipeline")
+                .long("mca-report")
+        )
+        .arg(
+            Arg::with_name("flag")
+                .help("set a compiler flag, e.g. -fno-builtin")
+                .short("f")
+                .takes_value(true)
+                .multiple(true)
+                .number_of_values(1)
+        )
+        .arg(
+            Arg::with_name("cache-dir")
+                .help("reuse objects and ir from this cache directory, defaults to $MCC_CACHE_DIR")
+                .takes_value(true)
+                .long("cache-dir")
+                .multiple(false)
+        )
+        .arg(
+            Arg::with_name("cache-size")
+                .help("size limit of the cache directory in MiB")
+                .takes_value(true)
+                .long("cache-size")
+                .multiple(false)
+        )
+        .arg(
+            Arg::with_name("args")
+                .help("arguments passed to the program when running it, e.g. -t run a.c -- x y")
+                .multiple(true)
+                .last(true)
+        )
+        .arg(
+            Arg::with_name("server")
+                .help("serve compile requests on a unix socket, clients connect through MCC_SERVER=<socket>")
+                .takes_value(true)
+                .long("server")
+                .multiple(false)
+        )
         .arg(
             Arg::with_name("dev")
                 .help("dev mode")
                 .long("dev")
         ).get_matches_from(args.iter());
 
+    #[cfg(unix)]
+    {
+        if let Some(path) = matches.value_of("server") {
+            /* everything done here is inherited by the per request workers */
+            unsafe {
+                init_be(&CompileOptions::new(false));
+                deinit_be();
+            }
+            server::serve(path, &|args| run(args, parser));
+        }
+    }
+
     let elf_stuff = ("elf", "");
     let obj_stuff = ("obj", ".o");
+    let asm_stuff = ("asm", ".s");
     let ir_stuff = ("ir", ".ll");
     let ast_stuff = ("ast", ".ast.json");
+    let run_stuff = ("run", "");
+    let pch_stuff = ("pch", ".pch");
 
     let (target, suf) = if !matches.is_present("compile") {
         match matches.value_of("target") {
             Some("elf") => elf_stuff,
             Some("obj") => obj_stuff,
+            Some("asm") => asm_stuff,
             Some("ir") => ir_stuff,
             Some("ast") => ast_stuff,
+            Some("run") => run_stuff,
+            Some("pch") => pch_stuff,
             None => elf_stuff,
             Some(what) => {
                 println!("unknown target: {}", what);
@@ -143,17 +282,131 @@ fn main_rs(args: Vec<&str>) -> Result<(), std::io::Error> {
         std::process::exit(0);
     };
 
+    if target == "run" && in_files.len() != 1 {
+        println!("target `run` takes exactly one input file");
+        std::process::exit(0);
+    }
+
     let mut logger = Logger::from(&mut stderr);
 
+    let mut opts = CompileOptions::new(matches.is_present("dev"));
+    opts.debug_info = matches.is_present("debug-info") as i32;
+    opts.mca_report = matches.is_present("mca-report") as i32;
+    for option in matches.values_of_lossy("machine").unwrap_or(vec![]).iter() {
+        if let Err(err) = opts.set_machine(option) {
+            logger.log(&LogItem {
+                level: Severity::Error,
+                location: None,
+                message: err.into(),
+            });
+            error_exit!()(());
+        }
+    }
+    for flag in matches.values_of_lossy("flag").unwrap_or(vec![]).iter() {
+        if let Err(err) = opts.set_flag(flag) {
+            logger.log(&LogItem {
+                level: Severity::Error,
+                location: None,
+                message: err.into(),
+            });
+            error_exit!()(());
+        }
+    }
+    for remark in matches.values_of_lossy("remark").unwrap_or(vec![]).iter() {
+        if let Err(err) = opts.set_remark(remark) {
+            logger.log(&LogItem {
+                level: Severity::Error,
+                location: None,
+                message: err.into(),
+            });
+            error_exit!()(());
+        }
+    }
+
+    let triple = matches
+        .value_of("triple")
+        .map(|x| CString::new(x).unwrap());
+    if let Some(triple) = &triple {
+        if target == "run" {
+            println!("target `run` can only execute code for the host");
+            std::process::exit(0);
+        }
+        opts.triple = triple.as_ptr();
+    }
+
+    /* only compiles that emit no diagnostics are cached, so warnings are never lost,
+     * nor are optimization records, which only codegen writes */
+    let cache_dir = matches
+        .value_of("cache-dir")
+        .map(|x| String::from(x))
+        .or(std::env::var("MCC_CACHE_DIR").ok())
+        .filter(|x| !x.is_empty())
+        .filter(|_| opts.save_opt_record == 0);
+    let cache_size = match matches.value_of("cache-size").map(|x| x.parse::<u64>()) {
+        Some(Ok(size)) => size << 20,
+        Some(Err(_)) => {
+            println!("invalid cache size: {}", matches.value_of("cache-size").unwrap());
+            std::process::exit(0);
+        }
+        None => cache::DEFAULT_MAX_SIZE,
+    };
+    let cache_suffix = match target {
+        "ir" => Some(".ll"),
+        "obj" | "elf" => Some(".o"),
+        "asm" => Some(".s"),
+        _ => None,
+    };
+    let cache = cache_dir
+        .filter(|_| cache_suffix.is_some())
+        .map(|dir| Cache::new(&dir, cache_size));
+    let mut cache_parts: Vec<String> = vec![
+        cache_suffix.unwrap_or("").into(),
+        matches.value_of("triple").unwrap_or("host").into(),
+        format!("dev={}", matches.is_present("dev")),
+        format!("g={}", matches.is_present("debug-info")),
+        format!("mca={}", matches.is_present("mca-report")),
+    ];
+    cache_parts.append(
+        &mut matches
+            .values_of_lossy("machine")
+            .unwrap_or(vec!["cpu=generic".into()]),
+    );
+    cache_parts.append(&mut matches.values_of_lossy("flag").unwrap_or(vec![]));
+    cache_parts.append(&mut matches.values_of_lossy("remark").unwrap_or(vec![]));
+    /* a profile or list changes the output without changing the command line */
+    for flag in matches.values_of_lossy("flag").unwrap_or(vec![]).iter() {
+        if flag.starts_with("profile-use=")
+            || flag.starts_with("profile-sample-use=")
+            || flag.starts_with("xray-always-instrument=")
+            || flag.starts_with("xray-never-instrument=")
+        {
+            cache_parts.push(cache::file_digest(&flag[flag.find('=').unwrap() + 1..]));
+        }
+    }
+
     // let mut contents = String::new();
     // in_file.read_to_string(&mut contents)?;
 
+    let pch = if target == "pch" {
+        None
+    } else {
+        matches.value_of("include-pch").map(|path| {
+            Pch::read(path).unwrap_or_else(|err| {
+                logger.log(&LogItem {
+                    level: Severity::Error,
+                    location: None,
+                    message: err,
+                });
+                error_exit!()(())
+            })
+        })
+    };
+
     /* preprocessing */
     let preprocessor = Preprocessor::new();
-    let parser = LRParser::<C, CLexer>::new();
     let msg;
     unsafe {
-        msg = init_be(if matches.is_present("dev") { 1 } else { 0 });
+        msg = init_be(&opts);
     }
     let msg = if msg == std::ptr::null() {
         &MsgList {
@@ -183,9 +436,66 @@ fn main_rs(args: Vec<&str>) -> Result<(), std::io::Error> {
             .value_of("output")
             .unwrap_or(default_out_file.as_str());
 
-        let contents = preprocessor
-                .parse(in_file, &mut logger)
-                .unwrap_or_else(error_exit!());
+        let obj_out: String = if target == "obj" || target == "asm" {
+            out_file.into()
+        } else {
+            String::from("/tmp/") + name.next_name().as_str() + ".o"
+        };
+
+        let header = if target == "pch" {
+            match std::fs::canonicalize(in_file) {
+                Ok(path) => Some(path.to_string_lossy().into_owned()),
+                Err(err) => {
+                    logger.log(&LogItem {
+                        level: Severity::Error,
+                        location: None,
+                        message: format!("cannot read {}: {}", in_file, err),
+                    });
+                    error_exit!()(())
+                }
+            }
+        } else {
+            None
+        };
+        let contents = match &header {
+            Some(header) => preprocessor.include_header(header, &mut logger),
+            None => preprocessor.parse(in_file, pch.as_ref().map(|x| x.header.as_str()), &mut logger),
+        }
+        .unwrap_or_else(error_exit!());
+
+        let cache_key = cache.as_ref().map(|_| cache::Key::new(&contents, &cache_parts));
+        if let (Some(cache), Some(key)) = (&cache, &cache_key) {
+            let out = if target == "ir" { out_file } else { obj_out.as_str() };
+            if cache.fetch(key, cache_suffix.unwrap(), out) {
+                if target == "elf" {
+                    objs.push(obj_out);
+                }
+                continue;
+            }
+        }
+
+        /* a precompiled header stands in for the text it was built from */
+        let mut prefix_json = None;
+        lang::set_predefined_types(&[]);
+        let contents = match &pch {
+            Some(pch) if contents.starts_with(&pch.prefix) => {
+                lang::set_predefined_types(&pch.types);
+                prefix_json = Some(pch.ast_json.as_str());
+                contents[pch.prefix.len()..].to_string()
+            }
+            Some(pch) => {
+                logger.log(&LogItem {
+                    level: Severity::Warning,
+                    location: None,
+                    message: format!(
+                        "precompiled header of {} does not match how {} includes it, ignored",
+                        pch.header, in_file
+                    ),
+                });
+                contents
+            }
+            None => contents,
+        };
 
         /* parsing */
         let (ast, source_map) = parser
@@ -201,33 +511,96 @@ fn main_rs(args: Vec<&str>) -> Result<(), std::io::Error> {
             continue;
         }
 
-        /* ir-generation */
-        let ir = ir_gen(&ast).unwrap_or_else(error_exit!());
+        /* ir-generation, `-t ir` streams the text straight into the output file */
+        let mut ir_out = if target == "ir" {
+            Some(std::io::BufWriter::new(File::create(out_file)?))
+        } else {
+            None
+        };
+        ir_gen(prefix_json, &ast, &contents, ir_out.as_mut().map(|x| x as &mut dyn Write))?;
+        if let Some(mut out) = ir_out {
+            out.flush()?;
+        }
 
+        let clean = msg.len == 0;
         if !msg.log(&contents, &mut logger, &source_map) {
+            if target == "ir" {
+                let _ = std::fs::remove_file(out_file);
+            }
             error_exit!()(());
         }
         unsafe {
             clear_msg();
         }
 
+        if let Some(header) = header {
+            Pch {
+                header: header,
+                prefix: contents,
+                types: lang::global_types(),
+                ast_json: ast.to_json(),
+            }
+            .write(out_file)?;
+            continue;
+        }
+
         if target == "ir" {
-            let mut out = File::create(out_file)?;
-            out.write(ir.as_bytes())?;
+            if let (Some(cache), Some(key), true) = (&cache, &cache_key, clean) {
+                let _ = cache.store(key, ".ll", out_file);
+            }
             continue;
         }
 
-        let obj_out: String = if target == "obj" {
-            out_file.into()
-        } else {
-            String::from("/tmp/") + name.next_name().as_str() + ".o"
+        if target == "run" {
+            /* argv[0] is the source file, just like a script interpreter */
+            let run_args: Vec<CString> = std::iter::once(in_file.clone())
+                .chain(matches.values_of_lossy("args").unwrap_or(vec![]))
+                .map(|x| CString::new(x).unwrap())
+                .collect();
+            let mut run_argv: Vec<*const c_char> = run_args.iter().map(|x| x.as_ptr()).collect();
+            run_argv.push(std::ptr::null());
+
+            let mut exit_code = 0;
+            let irc_val =
+                unsafe { irc_run(run_args.len() as i32, run_argv.as_ptr(), &mut exit_code) };
+
+            if !msg.log(&contents, &mut logger, &source_map) || irc_val != 0 {
+                error_exit!()(());
+            }
+            unsafe {
+                deinit_be();
+            }
+            std::process::exit(exit_code);
+        }
+
+        /* named after the object, or after the source when it is linked right away */
+        let record_file = CString::new(
+            std::path::Path::new(if target == "obj" || target == "asm" {
+                out_file
+            } else {
+                in_file.as_str()
+            })
+            .with_extension("opt.yaml")
+            .to_string_lossy()
+            .into_owned(),
+        )
+        .unwrap();
+        let irc_into = if target == "asm" { irc_into_asm } else { irc_into_obj };
+        let irc_val = unsafe {
+            irc_into(
+                CString::new(obj_out.as_str()).unwrap().as_ptr(),
+                record_file.as_ptr(),
+            )
         };
-        let irc_val = unsafe { irc_into_obj(CString::new(obj_out.as_str()).unwrap().as_ptr()) };
-        objs.push(obj_out);
 
+        let clean = clean && msg.len == 0;
         if !msg.log(&contents, &mut logger, &source_map) || irc_val != 0 {
             error_exit!()(());
         }
+        if let (Some(cache), Some(key), true) = (&cache, &cache_key, clean) {
+            let _ = cache.store(key, cache_suffix.unwrap(), &obj_out);
+        }
+        objs.push(obj_out);
         unsafe {
             clear_msg();
         }
@@ -247,7 +620,32 @@ fn main_rs(args: Vec<&str>) -> Result<(), std::io::Error> {
             .collect();
         args.append(&mut libs);
 
-        let child = Command::new("gcc").args(args.as_slice()).output().unwrap();
+        /* the work-sharing runtime of `#pragma omp parallel for` runs on pthreads */
+        args.push("-pthread".into());
+
+        /* gcc knows nothing of llvm's runtimes, clang links them for us */
+        let mut needs_clang = false;
+        if !opts.profile_generate.is_null() {
+            args.push("-fprofile-generate".into());
+            needs_clang = true;
+        }
+        if opts.xray_instrument != 0 {
+            args.push("-fxray-instrument".into());
+            needs_clang = true;
+        }
+        let linker = if needs_clang {
+            llvm_clang().unwrap_or_else(|err| {
+                logger.log(&LogItem {
+                    level: Severity::Error,
+                    location: None,
+                    message: err,
+                });
+                error_exit!()(())
+            })
+        } else {
+            String::from("gcc")
+        };
+        let child = Command::new(&linker).args(args.as_slice()).output().unwrap();
 
         let errs = String::from_utf8(child.stderr.to_vec()).unwrap();
 
@@ -268,19 +666,37 @@ fn main_rs(args: Vec<&str>) -> Result<(), std::io::Error> {
     Ok(())
 }
 
+fn run(args: Vec<&str>, parser: &LRParser<C, CLexer>) -> i32 {
+    match main_rs(args, parser) {
+        Ok(_) => 0,
+        Err(e) => {
+            println!("uncaught error: {}", e);
+            1
+        }
+    }
+}
+
 #[no_mangle]
 pub fn main(argc: i32, argv: *const *const i8) -> i32 {
     unsafe {
         let args = Vec::from_iter(
             (0..argc as isize).map(|i| CStr::from_ptr(*argv.offset(i)).to_str().unwrap()),
         );
-        match main_rs(args) {
-            Ok(_) => {}
-            Err(e) => {
-                println!("uncaught error: {}", e);
-                std::process::exit(1);
+        #[cfg(unix)]
+        {
+            if let Ok(path) = std::env::var("MCC_SERVER") {
+                if !args.iter().any(|x| x.starts_with("--server")) {
+                    if let Some(code) = server::forward(&path, &args) {
+                        std::process::exit(code);
+                    }
+                }
             }
         }
+        let parser = LRParser::<C, CLexer>::new();
+        match run(args, &parser) {
+            0 => {}
+            code => std::process::exit(code),
+        }
         0
     }
 }
@@ -5,6 +5,7 @@ use std::os::raw::c_char;
 
 const MSG_TYPE_ERROR: i32 = 0;
 const MSG_TYPE_WARNING: i32 = 1;
+const MSG_TYPE_REMARK: i32 = 2;
 
 #[repr(C)]
 pub struct Msg {
@@ -34,7 +35,8 @@ impl MsgList {
                             error = true;
                             Severity::Error
                         }
-                        MSG_TYPE_WARNING => Severity::Warning,
+                        /* remarks end in the -R flag that asked for them */
+                        MSG_TYPE_WARNING | MSG_TYPE_REMARK => Severity::Warning,
                         e @ _ => panic!(format!("unknown severity type: {}", e)),
                     },
                     location: if msg_chunk.has_loc != 0 {
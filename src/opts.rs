@@ -0,0 +1,182 @@
+use std::ffi::CString;
+use std::os::raw::c_char;
+
+#[repr(C)]
+pub struct CompileOptions {
+    pub debug: i32,
+    pub no_builtin: i32,
+    /* target triple, null for the host; copied by `init_be` */
+    pub triple: *const c_char,
+    /* function bodies are generated by this many forked workers, 0 or 1 for none */
+    pub irgen_jobs: i32,
+    /* the module is split into this many parts compiled on their own threads */
+    pub codegen_jobs: i32,
+    /* floating point model, see `set_flag` */
+    pub fast_math: i32,
+    pub math_errno: i32,
+    pub finite_math: i32,
+    pub assoc_math: i32,
+    pub fp_contract: i32,
+    /* directory the instrumented program writes its profile to, "" for the working one */
+    pub profile_generate: *const c_char,
+    /* indexed profile (.profdata) to optimize for */
+    pub profile_use: *const c_char,
+    /* sample profile (perf data converted for llvm) to optimize for */
+    pub profile_sample_use: *const c_char,
+    /* -g, types and variables besides the line tables */
+    pub debug_info: i32,
+    pub no_omit_frame_pointer: i32,
+    /* xray sleds in functions of at least `xray_threshold` instructions,
+     * the lists name functions always or never instrumented, `fun:name` per line */
+    pub xray_instrument: i32,
+    pub xray_threshold: i32,
+    pub xray_always: *const c_char,
+    pub xray_never: *const c_char,
+    /* regexes of the passes whose remarks are reported, see `set_remark` */
+    pub rpass: *const c_char,
+    pub rpass_missed: *const c_char,
+    pub rpass_analysis: *const c_char,
+    pub save_opt_record: i32,
+    /* -mcpu, null for a generic one */
+    pub cpu: *const c_char,
+    /* --mca-report, the loops are simulated on the pipeline of `cpu` */
+    pub mca_report: i32,
+}
+
+pub const FP_CONTRACT_OFF: i32 = 0;
+pub const FP_CONTRACT_ON: i32 = 1;
+pub const FP_CONTRACT_FAST: i32 = 2;
+
+impl CompileOptions {
+    pub fn new(debug: bool) -> Self {
+        CompileOptions {
+            debug: debug as i32,
+            no_builtin: 0,
+            triple: std::ptr::null(),
+            irgen_jobs: 0,
+            codegen_jobs: 0,
+            fast_math: 0,
+            math_errno: 1,
+            finite_math: 0,
+            assoc_math: 0,
+            fp_contract: FP_CONTRACT_OFF,
+            profile_generate: std::ptr::null(),
+            profile_use: std::ptr::null(),
+            profile_sample_use: std::ptr::null(),
+            debug_info: 0,
+            no_omit_frame_pointer: 0,
+            xray_instrument: 0,
+            xray_threshold: 200,
+            xray_always: std::ptr::null(),
+            xray_never: std::ptr::null(),
+            rpass: std::ptr::null(),
+            rpass_missed: std::ptr::null(),
+            rpass_analysis: std::ptr::null(),
+            save_opt_record: 0,
+            cpu: std::ptr::null(),
+            mca_report: 0,
+        }
+    }
+
+    /* apply a gcc style `-f<flag>` */
+    pub fn set_flag(&mut self, flag: &str) -> Result<(), String> {
+        match flag {
+            "builtin" => self.no_builtin = 0,
+            "no-builtin" => self.no_builtin = 1,
+            /* like gcc, -ffast-math implies the others */
+            "fast-math" => {
+                self.fast_math = 1;
+                self.math_errno = 0;
+                self.finite_math = 1;
+                self.assoc_math = 1;
+                self.fp_contract = FP_CONTRACT_FAST;
+            }
+            "no-fast-math" => self.fast_math = 0,
+            "math-errno" => self.math_errno = 1,
+            "no-math-errno" => self.math_errno = 0,
+            "finite-math-only" => self.finite_math = 1,
+            "no-finite-math-only" => self.finite_math = 0,
+            "associative-math" => self.assoc_math = 1,
+            "no-associative-math" => self.assoc_math = 0,
+            "fp-contract=off" => self.fp_contract = FP_CONTRACT_OFF,
+            "fp-contract=on" => self.fp_contract = FP_CONTRACT_ON,
+            "fp-contract=fast" => self.fp_contract = FP_CONTRACT_FAST,
+            "omit-frame-pointer" => self.no_omit_frame_pointer = 0,
+            "no-omit-frame-pointer" => self.no_omit_frame_pointer = 1,
+            "save-optimization-record" => self.save_opt_record = 1,
+            "no-save-optimization-record" => self.save_opt_record = 0,
+            "profile-generate" => self.profile_generate = c_string(""),
+            _ if flag.starts_with("profile-generate=") => {
+                self.profile_generate = c_string(value(flag))
+            }
+            _ if flag.starts_with("profile-use=") => self.profile_use = c_string(value(flag)),
+            _ if flag.starts_with("profile-sample-use=") => {
+                self.profile_sample_use = c_string(value(flag))
+            }
+            "xray-instrument" => self.xray_instrument = 1,
+            "no-xray-instrument" => self.xray_instrument = 0,
+            _ if flag.starts_with("xray-instruction-threshold=") => {
+                self.xray_threshold = value(flag)
+                    .parse()
+                    .ok()
+                    .filter(|&n| n >= 0)
+                    .ok_or_else(|| format!("invalid instruction threshold: -f{}", flag))?
+            }
+            _ if flag.starts_with("xray-always-instrument=") => {
+                self.xray_always = c_string(value(flag))
+            }
+            _ if flag.starts_with("xray-never-instrument=") => {
+                self.xray_never = c_string(value(flag))
+            }
+            _ if flag.starts_with("parallel-irgen=") => self.irgen_jobs = jobs(flag)?,
+            _ if flag.starts_with("parallel-codegen=") => self.codegen_jobs = jobs(flag)?,
+            _ => return Err(format!("unknown compiler flag: -f{}", flag)),
+        }
+        Ok(())
+    }
+}
+
+impl CompileOptions {
+    /* apply a clang style `-R<remark>=regex` */
+    pub fn set_remark(&mut self, remark: &str) -> Result<(), String> {
+        match remark {
+            _ if remark.starts_with("pass=") => self.rpass = c_string(value(remark)),
+            _ if remark.starts_with("pass-missed=") => self.rpass_missed = c_string(value(remark)),
+            _ if remark.starts_with("pass-analysis=") => {
+                self.rpass_analysis = c_string(value(remark))
+            }
+            _ => return Err(format!("unknown remark: -R{}", remark)),
+        }
+        Ok(())
+    }
+}
+
+impl CompileOptions {
+    /* apply a gcc style `-m<option>=value` */
+    pub fn set_machine(&mut self, option: &str) -> Result<(), String> {
+        match option {
+            _ if option.starts_with("cpu=") => self.cpu = c_string(value(option)),
+            _ => return Err(format!("unknown machine option: -m{}", option)),
+        }
+        Ok(())
+    }
+}
+
+/* the `value` of `-f<flag>=value` */
+fn value(flag: &str) -> &str {
+    &flag[flag.find('=').unwrap() + 1..]
+}
+
+/* options are set once per compile, their strings simply live until exit */
+fn c_string(s: &str) -> *const c_char {
+    CString::new(s).unwrap().into_raw()
+}
+
+/* the `N` of `-f<flag>=N` */
+fn jobs(flag: &str) -> Result<i32, String> {
+    value(flag)
+        .parse()
+        .ok()
+        .filter(|&n| n > 0)
+        .ok_or_else(|| format!("invalid number of jobs: -f{}", flag))
+}
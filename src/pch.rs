@@ -0,0 +1,70 @@
+/* precompiled headers
+ *
+ * A precompiled header records what a translation unit starting with
+ * `#include "<header>"` looks like after its first line: the preprocessed
+ * text of the header, the typedef names it declares and the ast of its
+ * declarations. A compile using it checks that its own preprocessed text
+ * starts with the recorded text, then only parses the rest and lets
+ * ir-gen replay the header ast in front of it.
+ */
+
+use std::fs;
+
+const MAGIC: &str = "mcc-pch";
+
+pub struct Pch {
+    pub header: String,
+    pub prefix: String,
+    pub types: Vec<String>,
+    pub ast_json: String,
+}
+
+fn put(buf: &mut String, section: &str) {
+    buf.push_str(&format!("{}\n", section.len()));
+    buf.push_str(section);
+}
+
+fn get<'a>(buf: &mut &'a str) -> Option<&'a str> {
+    let eol = buf.find('\n')?;
+    let len = buf[..eol].parse::<usize>().ok()?;
+    let section = buf.get(eol + 1..eol + 1 + len)?;
+    *buf = &buf[eol + 1 + len..];
+    Some(section)
+}
+
+impl Pch {
+    pub fn write(&self, path: &str) -> std::io::Result<()> {
+        let mut buf = format!("{} {}\n", MAGIC, env!("CARGO_PKG_VERSION"));
+        put(&mut buf, &self.header);
+        put(&mut buf, &self.prefix);
+        put(&mut buf, &self.types.join("\n"));
+        put(&mut buf, &self.ast_json);
+        fs::write(path, buf)
+    }
+
+    pub fn read(path: &str) -> Result<Self, String> {
+        let data = fs::read_to_string(path).map_err(|err| format!("cannot read {}: {}", path, err))?;
+        let invalid = || format!("{} is not a precompiled header of this mcc", path);
+
+        let eol = data.find('\n').ok_or_else(invalid)?;
+        if data[..eol] != format!("{} {}", MAGIC, env!("CARGO_PKG_VERSION")) {
+            return Err(invalid());
+        }
+        let mut buf = &data[eol + 1..];
+        let header = get(&mut buf).ok_or_else(invalid)?.into();
+        let prefix = get(&mut buf).ok_or_else(invalid)?.into();
+        let types = get(&mut buf).ok_or_else(invalid)?;
+        let ast_json = get(&mut buf).ok_or_else(invalid)?.into();
+
+        Ok(Pch {
+            header: header,
+            prefix: prefix,
+            types: types
+                .split('\n')
+                .filter(|x| !x.is_empty())
+                .map(|x| x.into())
+                .collect(),
+            ast_json: ast_json,
+        })
+    }
+}
@@ -2,6 +2,59 @@ use std::io::prelude::*;
 use std::process::{Command, Stdio};
 
 use myrpg::*;
+use std::path::Path;
+use std::thread;
+
+fn escape(path: &str) -> String {
+    path.replace('\\', "\\\\").replace('"', "\\\"")
+}
+
+fn include_line(header: &str) -> String {
+    format!("#include \"{}\"\n", escape(header))
+}
+
+/* spells the `__attribute__` tokens of the code `__attribute`, string and
+ * character literals and comments are kept as they are */
+fn rename_attributes(source: &str) -> String {
+    let bytes = source.as_bytes();
+    let mut out = String::with_capacity(source.len());
+    let mut i = 0;
+    while i < bytes.len() {
+        let start = i;
+        match bytes[i] {
+            quote @ b'"' | quote @ b'\'' => {
+                i += 1;
+                while i < bytes.len() && bytes[i] != quote && bytes[i] != b'\n' {
+                    i += if bytes[i] == b'\\' { 2 } else { 1 };
+                }
+                i += 1;
+            }
+            b'/' if bytes.get(i + 1) == Some(&b'/') => {
+                while i < bytes.len() && bytes[i] != b'\n' {
+                    i += if bytes[i] == b'\\' { 2 } else { 1 };
+                }
+            }
+            b'/' if bytes.get(i + 1) == Some(&b'*') => {
+                i = source[i + 2..]
+                    .find("*/")
+                    .map_or(bytes.len(), |end| i + 2 + end + 2);
+            }
+            c if c == b'_' || c.is_ascii_alphanumeric() => {
+                while i < bytes.len() && (bytes[i] == b'_' || bytes[i].is_ascii_alphanumeric()) {
+                    i += 1;
+                }
+                if &source[start..i] == "__attribute__" {
+                    out.push_str("__attribute");
+                    continue;
+                }
+            }
+            _ => i += source[i..].chars().next().map_or(1, |c| c.len_utf8()),
+        }
+        i = i.min(bytes.len());
+        out.push_str(&source[start..i]);
+    }
+    out
+}
 
 pub struct Preprocessor {}
 
@@ -35,7 +88,55 @@ impl Preprocessor {
     pub fn new() -> Self {
         Preprocessor {}
     }
-    pub fn parse(&self, in_file: &str, logger: &mut Logger) -> Result<String, ()> {
+    /* `pch_header` is the absolute path of the header a precompiled header
+     * was built from, it is included ahead of the file exactly like
+     * `include_header` does so the output starts with the same text */
+    pub fn parse(
+        &self,
+        in_file: &str,
+        pch_header: Option<&str>,
+        logger: &mut Logger,
+    ) -> Result<String, ()> {
+        /* system headers `#define __attribute__(x)` to nothing when
+         * __GNUC__ is undefined, so the user's attributes are spelled
+         * `__attribute` which is kept as is */
+        let source = match std::fs::read_to_string(in_file) {
+            Ok(source) => source,
+            Err(err) => {
+                logger.log(&LogItem {
+                    level: Severity::Error,
+                    location: None,
+                    message: format!("cannot read {}: {}", in_file, err),
+                });
+                return Err(());
+            }
+        };
+        let source = format!(
+            "{}#line 1 \"{}\"\n{}",
+            pch_header.map_or(String::new(), |x| include_line(x)),
+            escape(in_file),
+            rename_attributes(&source)
+        );
+        let dir = Path::new(in_file)
+            .parent()
+            .and_then(|x| x.to_str())
+            .filter(|x| !x.is_empty())
+            .unwrap_or(".");
+
+        self.run(&source, dir, logger)
+    }
+
+    /* preprocess nothing but an include of `header`, used to build precompiled headers */
+    pub fn include_header(&self, header: &str, logger: &mut Logger) -> Result<String, ()> {
+        let dir = Path::new(header)
+            .parent()
+            .and_then(|x| x.to_str())
+            .filter(|x| !x.is_empty())
+            .unwrap_or(".");
+        self.run(&include_line(header), dir, logger)
+    }
+
+    fn run(&self, source: &str, dir: &str, logger: &mut Logger) -> Result<String, ()> {
         let child = Command::new("gcc")
             .args(&[
                 "-E",
@@ -43,23 +144,57 @@ impl Preprocessor {
                 "-U__GNUC__",
                 "-U__GNUC_MINOR__",
                 "-U__GNUC_PATCHLEVEL__",
-                in_file,
+                "-iquote",
+                dir,
+                "-x",
+                "c",
+                "-",
             ])
-            .output()
-            .unwrap();
+            .stdin(Stdio::piped())
+            .stdout(Stdio::piped())
+            .stderr(Stdio::piped())
+            .spawn();
+        let mut child = match child {
+            Ok(child) => child,
+            Err(err) => return Self::error(logger, format!("cannot run gcc: {}", err)),
+        };
+        /* gcc blocks writing a large output into the pipe before it has
+         * read all of the source, so the source is fed from another thread */
+        let mut stdin = child.stdin.take().unwrap();
+        let input = source.to_owned();
+        let writer = thread::spawn(move || stdin.write_all(input.as_bytes()));
+        let child = child.wait_with_output();
+        let written = writer.join();
 
-        if child.status.success() {
-            Ok(String::from_utf8(child.stdout.to_vec()).unwrap())
-        } else {
-            logger.log(&LogItem {
-                level: Severity::Error,
-                location: None,
-                message: format!(
+        let child = match child {
+            Ok(child) => child,
+            Err(err) => return Self::error(logger, format!("cannot run gcc: {}", err)),
+        };
+        if !child.status.success() {
+            return Self::error(
+                logger,
+                format!(
                     "preprocessing error:\n{}",
-                    String::from_utf8(child.stderr.to_vec()).unwrap().trim()
+                    String::from_utf8_lossy(&child.stderr).trim()
                 ),
-            });
-            Err(())
+            );
+        }
+        match written {
+            Ok(Ok(())) => {}
+            Ok(Err(err)) => return Self::error(logger, format!("cannot write to gcc: {}", err)),
+            Err(_) => return Self::error(logger, "cannot write to gcc".to_owned()),
         }
+        String::from_utf8(child.stdout).or_else(|err| {
+            Self::error(logger, format!("preprocessed source is not utf-8: {}", err))
+        })
+    }
+
+    fn error<T>(logger: &mut Logger, message: String) -> Result<T, ()> {
+        logger.log(&LogItem {
+            level: Severity::Error,
+            location: None,
+            message,
+        });
+        Err(())
     }
 }
@@ -0,0 +1,241 @@
+/* compile server
+ *
+ * `mcc --server <socket>` builds the parser tables and initializes the
+ * backend once, then forks for every request so each compile starts from
+ * that warm state and requests run concurrently without sharing the
+ * (global) ir-gen state.
+ *
+ * With `MCC_SERVER=<socket>` in the environment mcc becomes a thin client:
+ * it sends argv, cwd and env together with its stdin/stdout/stderr, so
+ * diagnostics and outputs go straight to the caller, and exits with the
+ * status of the remote compile.
+ */
+
+use std::env;
+use std::io::prelude::*;
+use std::io::{Error, ErrorKind, Result};
+use std::mem;
+use std::os::unix::io::{AsRawFd, RawFd};
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::ptr;
+
+const STDIO: [RawFd; 3] = [0, 1, 2];
+
+fn put_str(buf: &mut Vec<u8>, s: &str) {
+    buf.extend_from_slice(&(s.len() as u32).to_le_bytes());
+    buf.extend_from_slice(s.as_bytes());
+}
+
+fn put_list<T: AsRef<str>>(buf: &mut Vec<u8>, list: &[T]) {
+    buf.extend_from_slice(&(list.len() as u32).to_le_bytes());
+    for s in list.iter() {
+        put_str(buf, s.as_ref());
+    }
+}
+
+fn get_u32(buf: &mut &[u8]) -> Result<u32> {
+    if buf.len() < 4 {
+        return Err(Error::new(ErrorKind::InvalidData, "truncated request"));
+    }
+    let mut val = [0u8; 4];
+    val.copy_from_slice(&buf[..4]);
+    *buf = &buf[4..];
+    Ok(u32::from_le_bytes(val))
+}
+
+fn get_str(buf: &mut &[u8]) -> Result<String> {
+    let len = get_u32(buf)? as usize;
+    if buf.len() < len {
+        return Err(Error::new(ErrorKind::InvalidData, "truncated request"));
+    }
+    let s = String::from_utf8(buf[..len].to_vec())
+        .map_err(|_| Error::new(ErrorKind::InvalidData, "request is not utf-8"))?;
+    *buf = &buf[len..];
+    Ok(s)
+}
+
+fn get_list(buf: &mut &[u8]) -> Result<Vec<String>> {
+    let len = get_u32(buf)?;
+    (0..len).map(|_| get_str(buf)).collect()
+}
+
+/* send `data` with `fds` attached as SCM_RIGHTS */
+fn send_fds(sock: RawFd, data: &[u8], fds: &[RawFd]) -> Result<()> {
+    unsafe {
+        let fds_len = mem::size_of_val(fds) as u32;
+        let mut cbuf = vec![0u8; libc::CMSG_SPACE(fds_len) as usize];
+        let mut iov = libc::iovec {
+            iov_base: data.as_ptr() as *mut libc::c_void,
+            iov_len: data.len(),
+        };
+        let mut msg: libc::msghdr = mem::zeroed();
+        msg.msg_iov = &mut iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cbuf.as_mut_ptr() as *mut libc::c_void;
+        msg.msg_controllen = cbuf.len() as _;
+
+        let cmsg = libc::CMSG_FIRSTHDR(&msg);
+        (*cmsg).cmsg_level = libc::SOL_SOCKET;
+        (*cmsg).cmsg_type = libc::SCM_RIGHTS;
+        (*cmsg).cmsg_len = libc::CMSG_LEN(fds_len) as _;
+        ptr::copy_nonoverlapping(fds.as_ptr(), libc::CMSG_DATA(cmsg) as *mut RawFd, fds.len());
+
+        if libc::sendmsg(sock, &msg, 0) != data.len() as isize {
+            return Err(Error::last_os_error());
+        }
+    }
+    Ok(())
+}
+
+/* receive exactly `data.len()` bytes, returns the fds sent along with them */
+fn recv_fds(sock: RawFd, data: &mut [u8], max_fds: usize) -> Result<Vec<RawFd>> {
+    let mut fds = vec![];
+    unsafe {
+        let mut cbuf = vec![0u8; libc::CMSG_SPACE((max_fds * mem::size_of::<RawFd>()) as u32) as usize];
+        let mut iov = libc::iovec {
+            iov_base: data.as_mut_ptr() as *mut libc::c_void,
+            iov_len: data.len(),
+        };
+        let mut msg: libc::msghdr = mem::zeroed();
+        msg.msg_iov = &mut iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cbuf.as_mut_ptr() as *mut libc::c_void;
+        msg.msg_controllen = cbuf.len() as _;
+
+        if libc::recvmsg(sock, &mut msg, libc::MSG_WAITALL) != data.len() as isize {
+            return Err(Error::new(ErrorKind::UnexpectedEof, "truncated request"));
+        }
+
+        let mut cmsg = libc::CMSG_FIRSTHDR(&msg);
+        while !cmsg.is_null() {
+            if (*cmsg).cmsg_level == libc::SOL_SOCKET && (*cmsg).cmsg_type == libc::SCM_RIGHTS {
+                let n = ((*cmsg).cmsg_len as usize - libc::CMSG_LEN(0) as usize)
+                    / mem::size_of::<RawFd>();
+                let data = libc::CMSG_DATA(cmsg) as *const RawFd;
+                fds.extend((0..n).map(|i| *data.add(i)));
+            }
+            cmsg = libc::CMSG_NXTHDR(&msg, cmsg);
+        }
+    }
+    Ok(fds)
+}
+
+/* run `args` on the server listening at `path`, `None` if it is unreachable */
+pub fn forward(path: &str, args: &[&str]) -> Option<i32> {
+    let mut stream = UnixStream::connect(path).ok()?;
+
+    let mut req = vec![];
+    put_str(&mut req, env::current_dir().ok()?.to_str()?);
+    put_list(&mut req, args);
+    let envs: Vec<String> = env::vars_os()
+        .filter_map(|(k, v)| Some(format!("{}={}", k.to_str()?, v.to_str()?)))
+        .collect();
+    put_list(&mut req, &envs);
+
+    send_fds(stream.as_raw_fd(), &(req.len() as u32).to_le_bytes(), &STDIO).ok()?;
+    let mut status = [0u8; 4];
+    if stream.write_all(&req).is_err() || stream.read_exact(&mut status).is_err() {
+        eprintln!("mcc: lost connection to compile server {}", path);
+        return Some(1);
+    }
+    Some(i32::from_le_bytes(status))
+}
+
+/* worker side of a request, returns the exit status of the compile */
+fn handle(mut stream: UnixStream, run: &dyn Fn(Vec<&str>) -> i32) -> Result<i32> {
+    let mut len = [0u8; 4];
+    let fds = recv_fds(stream.as_raw_fd(), &mut len, STDIO.len())?;
+    if fds.len() != STDIO.len() {
+        return Err(Error::new(ErrorKind::InvalidData, "request carries no stdio"));
+    }
+    let mut req = vec![0u8; u32::from_le_bytes(len) as usize];
+    stream.read_exact(&mut req)?;
+
+    let mut buf = req.as_slice();
+    let cwd = get_str(&mut buf)?;
+    let args = get_list(&mut buf)?;
+    let envs = get_list(&mut buf)?;
+
+    let status = unsafe {
+        match libc::fork() {
+            -1 => return Err(Error::last_os_error()),
+            0 => {
+                drop(stream);
+                for (fd, &std_fd) in fds.iter().zip(STDIO.iter()) {
+                    libc::dup2(*fd, std_fd);
+                    libc::close(*fd);
+                }
+                if let Err(err) = env::set_current_dir(&cwd) {
+                    eprintln!("mcc: cannot enter {}: {}", cwd, err);
+                    libc::_exit(1);
+                }
+                for (k, _) in env::vars_os() {
+                    env::remove_var(k);
+                }
+                for var in envs.iter() {
+                    let mut kv = var.splitn(2, '=');
+                    if let (Some(k), Some(v)) = (kv.next(), kv.next()) {
+                        env::set_var(k, v);
+                    }
+                }
+                let code = run(args.iter().map(|x| x.as_str()).collect());
+                std::process::exit(code);
+            }
+            pid => {
+                for fd in fds.iter() {
+                    libc::close(*fd);
+                }
+                let mut status = 0;
+                libc::waitpid(pid, &mut status, 0);
+                if libc::WIFEXITED(status) {
+                    libc::WEXITSTATUS(status)
+                } else {
+                    128 + libc::WTERMSIG(status)
+                }
+            }
+        }
+    };
+    stream.write_all(&status.to_le_bytes())?;
+    Ok(status)
+}
+
+/* accept requests on `path` forever, `run` compiles a single command line */
+pub fn serve(path: &str, run: &dyn Fn(Vec<&str>) -> i32) -> ! {
+    let _ = std::fs::remove_file(path);
+    let listener = UnixListener::bind(path).unwrap_or_else(|err| {
+        eprintln!("mcc: cannot listen on {}: {}", path, err);
+        std::process::exit(1);
+    });
+
+    unsafe {
+        /* workers are never waited for, let the kernel reap them */
+        libc::signal(libc::SIGCHLD, libc::SIG_IGN);
+    }
+
+    for stream in listener.incoming() {
+        let stream = match stream {
+            Ok(stream) => stream,
+            Err(_) => continue,
+        };
+        match unsafe { libc::fork() } {
+            -1 => eprintln!("mcc: fork failed: {}", Error::last_os_error()),
+            0 => {
+                drop(listener);
+                unsafe {
+                    /* the worker waits for the compile itself */
+                    libc::signal(libc::SIGCHLD, libc::SIG_DFL);
+                }
+                let code = match handle(stream, run) {
+                    Ok(_) => 0,
+                    Err(err) => {
+                        eprintln!("mcc: bad request: {}", err);
+                        1
+                    }
+                };
+                std::process::exit(code);
+            }
+            _ => {}
+        }
+    }
+    std::process::exit(0);
+}
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+static int square( int x ) __attribute__( ( const ) );
+int sum( const int *a, int n ) __attribute__( ( pure, noinline ) );
+__attribute__( ( cold, noreturn ) ) void fail( const char *msg );
+__attribute__( ( hot ) ) static int step( int x );
+
+struct Box
+{
+	long v[ 4 ];
+};
+
+// returned through a hidden pointer, passed in memory
+struct Box twice( struct Box b ) __attribute__( ( const, noinline ) );
+
+static int square( int x )
+{
+	return x * x;
+}
+
+int sum( const int *a, int n )
+{
+	int i, s = 0;
+	for ( i = 0; i < n; ++i ) s = s + a[ i ];
+	return s;
+}
+
+void fail( const char *msg )
+{
+	puts( msg );
+	exit( 1 );
+}
+
+static int step( int x )
+{
+	return x + 1;
+}
+
+struct Box twice( struct Box b )
+{
+	int i;
+	for ( i = 0; i < 4; ++i ) b.v[ i ] = b.v[ i ] * 2;
+	return b;
+}
+
+int table[ 4 ] __attribute__( ( aligned( 32 ) ) ) = { 1, 2, 3, 4 };
+
+int main()
+{
+	int local[ 4 ] __attribute__( ( aligned ) );
+	int i;
+	for ( i = 0; i < 4; i = step( i ) ) local[ i ] = square( table[ i ] );
+	if ( sum( local, 4 ) != 30 ) fail( "wrong sum" );
+	printf( "%d\n", sum( local, 4 ) );
+	{
+		struct Box b = { { 1, 2, 3, 4 } };
+		b = twice( twice( b ) );
+		printf( "%ld\n", b.v[ 3 ] );
+	}
+	/* spelled as is: __attribute__( ( unused ) ) */
+	puts( "__attribute__( ( const ) )" );
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern int counter;
+int twice( int x ) __attribute__( ( const ) );
+int never_used( int x );
+
+int counter = 2;
+
+int twice( int x )
+{
+	return x * 2;
+}
+
+int main()
+{
+	extern int counter;
+	int ( *fn )( int ) = twice;
+	char buf[ 16 ];
+
+	strcpy( buf, "lazy" );
+	counter = fn( counter ) + twice( 1 );
+	printf( "%s %d %d\n", buf, counter, (int)strlen( buf ) );
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <string.h>
+
+struct Pair
+{
+	long first;
+	long second;
+};
+
+int main()
+{
+	struct Pair a, b;
+	int buf[ 8 ];
+	int i;
+
+	memset( &a, 0, sizeof( a ) );
+	a.first = 1;
+	a.second = 2;
+	memcpy( &b, &a, sizeof( b ) );
+	printf( "%ld %ld\n", b.first, b.second );
+
+	for ( i = 0; i < 8; ++i ) buf[ i ] = i;
+	memmove( buf + 1, buf, 4 * sizeof( int ) );
+	for ( i = 0; i < 8; ++i ) printf( "%d ", buf[ i ] );
+	puts( "" );
+
+	printf( "%d\n", (int)strlen( "hello" ) );
+}
\ No newline at end of file
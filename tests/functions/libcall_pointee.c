@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <string.h>
+
+struct Pair
+{
+	long first;
+	long second;
+};
+
+volatile int flags[ 4 ];
+
+int main()
+{
+	struct Pair a, b;
+	short half[ 4 ] = { 1, 2, 3, 4 };
+	int i;
+
+	/* the copies are lowered with the alignment of the pointees */
+	b.first = b.second = 7;
+	memset( &a, 0, sizeof( a ) );
+	a.second = 2;
+	memcpy( &b, &a, sizeof( b ) );
+	printf( "%ld %ld\n", b.first, b.second );
+
+	memmove( half + 1, half, 2 * sizeof( short ) );
+	printf( "%d %d %d %d\n", half[ 0 ], half[ 1 ], half[ 2 ], half[ 3 ] );
+
+	/* and stay volatile */
+	for ( i = 0; i < 4; ++i )
+	{
+		flags[ i ] = i + 1;
+	}
+	memset( flags, 0, sizeof( flags ) );
+	printf( "%d %d %d %d\n", flags[ 0 ], flags[ 1 ], flags[ 2 ], flags[ 3 ] );
+}
\ No newline at end of file
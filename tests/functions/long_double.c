@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+long double scale( long double x, long double y )
+{
+	return x * y + 0.1L;
+}
+
+int main()
+{
+	long double third = 1.0L / 3.0L;
+	long double sum = 0;
+	int i;
+
+	for ( i = 0; i < 3; i++ )
+	{
+		sum = sum + third;
+	}
+	printf( "%.18Lf %d\n", scale( sum, 2.5L ), third < 0.3333333333333333334L );
+	printf( "%d %d\n", (int)sizeof( long double ) >= (int)sizeof( double ), 0x1p-2L == 0.25L );
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include <stdio.h>
+
+int main()
+{
+	int a[ 64 ], b[ 64 ];
+	int i, sum = 0;
+
+#pragma GCC ivdep
+	for ( i = 0; i < 64; ++i )
+	{
+		a[ i ] = i;
+		b[ i ] = 2 * i;
+	}
+
+#pragma clang loop vectorize(enable) interleave_count(2)
+	for ( i = 0; i < 64; ++i )
+	{
+		a[ i ] = a[ i ] + b[ i ];
+	}
+
+	i = 0;
+#pragma unroll 4
+	while ( i < 64 )
+	{
+		sum = sum + a[ i ];
+		i = i + 1;
+	}
+
+#pragma nounroll
+	for ( i = 0; i < 4; )
+	{
+		i = i + 1;
+	}
+
+	printf( "%d %d\n", sum, i );
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include <stdio.h>
+
+int main()
+{
+	int a[ 1000 ];
+	int i, t, n = 1000;
+	long sum = 0;
+	double scaled = 0;
+
+#pragma omp parallel for schedule(static)
+	for ( i = 0; i < n; i++ )
+	{
+		a[ i ] = i;
+	}
+
+#pragma omp parallel for schedule(dynamic, 16) private(t) reduction(+:sum)
+	for ( i = n - 1; i >= 0; --i )
+	{
+		t = a[ i ] * 2;
+		sum += t;
+	}
+
+#pragma omp parallel for reduction(+:scaled)
+	for ( i = 0; i < n; i += 4 )
+	{
+		if ( a[ i ] % 8 ) continue;
+		scaled += a[ i ] * 0.5;
+	}
+
+	printf( "%ld %g %d\n", sum, scaled, i );
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <stdio.h>
+
+struct Later;
+struct Later swap( struct Later l );  /* classified once `struct Later` is complete */
+
+struct Point
+{
+	int x;
+	int y;
+};
+
+struct Mixed
+{
+	double d;
+	float f;
+};
+
+struct Big
+{
+	long a, b, c, d;
+};
+
+struct Later
+{
+	long lo, hi;
+};
+
+struct Wide
+{
+	long double x;
+};
+
+/* returned in st0 like gcc and clang do */
+struct Wide widen( double x )
+{
+	struct Wide w;
+	w.x = x;
+	return w;
+}
+
+struct Point make_point( int x, int y )
+{
+	struct Point p;
+	p.x = x;
+	p.y = y;
+	return p;
+}
+
+struct Mixed scale( struct Mixed m, double k )
+{
+	m.d = m.d * k;
+	m.f = m.f * k;
+	return m;
+}
+
+struct Big sum( struct Big lhs, struct Big rhs )
+{
+	lhs.a = lhs.a + rhs.a;
+	lhs.b = lhs.b + rhs.b;
+	lhs.c = lhs.c + rhs.c;
+	lhs.d = lhs.d + rhs.d;
+	return lhs;
+}
+
+int main()
+{
+	struct Point p = make_point( 1, 2 ), q;
+	struct Mixed m;
+	struct Big a, b, c;
+	struct Later l;
+
+	q = p;
+	q.y = make_point( 3, 4 ).y;
+	printf( "%d %d %d %d\n", p.x, p.y, q.x, q.y );
+
+	m.d = 1.5;
+	m.f = 2.5;
+	m = scale( m, 2 );
+	printf( "%f %f\n", m.d, m.f );
+
+	a.a = a.b = a.c = a.d = 1;
+	b = a;
+	c = sum( a, b );
+	printf( "%ld %ld %ld %ld\n", c.a, c.b, c.c, c.d );
+
+	l.lo = 1;
+	l.hi = 2;
+	l = swap( l );
+	printf( "%ld %ld\n", l.lo, l.hi );
+
+	printf( "%.1Lf\n", widen( 2.5 ).x );
+}
+
+struct Later swap( struct Later l )
+{
+	struct Later r;
+	r.lo = l.hi;
+	r.hi = l.lo;
+	return r;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include <stdio.h>
+
+union text
+{
+	char b[ 8 ];
+	int i;
+};
+
+struct tagged
+{
+	char tag;
+	union text u;
+};
+
+union text u = { "abc" };
+union text us[] = { { "de" }, { "fghijkl" } };
+struct tagged t = { 'x', { "mno" } };
+
+int main()
+{
+	union text local = { "pqr" };
+	printf( "%s %d\n", u.b, ( int )sizeof( u ) );
+	printf( "%s %s %d\n", us[ 0 ].b, us[ 1 ].b, ( int )sizeof( us ) );
+	printf( "%c %s\n", t.tag, t.u.b );
+	printf( "%s\n", local.b );
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include <stdio.h>
+
+typedef float v4sf __attribute__( ( vector_size( 16 ) ) );
+typedef int v4si __attribute__( ( vector_size( 16 ) ) );
+
+struct Pair
+{
+	double lo, hi;
+};
+
+/* the vectors take all eight sse registers, so `p` goes on the stack */
+static double spill( v4sf a, v4sf b, v4sf c, v4sf d, v4sf e, v4sf f, v4sf g, v4sf h, struct Pair p )
+{
+	v4sf r = a + b + c + d + e + f + g + h;
+	return r[ 0 ] + p.lo * p.hi;
+}
+
+static v4sf axpy( float a, v4sf x, v4sf y )
+{
+	return a * x + y;
+}
+
+int main()
+{
+	v4sf x = { 1.0f, 2.0f, 3.0f, 4.0f };
+	v4sf y = { 0.5f, 0.5f, 0.5f, 0.5f };
+	v4si mask, idx;
+	v4sf r;
+	struct Pair p = { 2.0, 3.0 };
+	int i;
+
+	r = axpy( 2.0f, x, y );
+	r[ 0 ] = -r[ 0 ];
+	mask = r > y;
+	idx = __builtin_convertvector( x, v4si ) ^ 1;
+	r = __builtin_shufflevector( r, x, 3, 2, 5, 4 );
+
+	for ( i = 0; i < 4; ++i )
+	{
+		printf( "%g %d %d\n", (double)r[ i ], mask[ i ], idx[ i ] );
+	}
+	printf( "%g\n", spill( x, x, x, x, y, y, y, y, p ) );
+}
\ No newline at end of file